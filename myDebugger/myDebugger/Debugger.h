@@ -12,29 +12,98 @@
 
 #include <iostream> //basic IO
 #include <stdint.h> //used for clock cycle benchmarking
+#ifdef _WIN32
 #include <intrin.h>
+#endif
 #include <chrono> //time benchmarking
 #include <tuple> //for memory containers
+#include <string>
+#include <sstream> //dumps are formatted before being written out
+#include <memory> //type_name buffer ownership
+#include <typeinfo>
+#ifndef _MSC_VER
+#include <cxxabi.h> //demangling for type_name
+#endif
+#include <atomic> //shared counters
+#include <map> //name-keyed registries
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <condition_variable> //background exporters
+#include <functional>
+#include <shared_mutex>
+#include <vector>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdio> //snprintf
+#include <ctime>
+#include <cstdlib>
+#include <cstddef> //offsetof for layout checks
+#ifdef _MSC_VER
+#define NOMINMAX //keeps windows.h from defining min/max macros over std::min/std::max
+#include "windows.h"
+#include "psapi.h" //gets info on current process: "process status API"
+
+#include <pdh.h>
+#include <pdhmsg.h>
+#include <dbghelp.h> //symbolising stack traces
+
+#pragma comment(lib,"pdh.lib")
+#pragma comment(lib,"dbghelp.lib")
+#else
+#include <pthread.h> //thread pinning
+#include <sched.h>
+#include <sys/resource.h> //getrusage for page faults and context switches
+#include <fstream> //reading /proc
+#include <unwind.h> //stack capture
+#include <elf.h> //symbol tables
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cpuid.h> //cpu model for tuning caches
+#include <sys/wait.h> //isolated benchmark children
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <sys/socket.h> //metrics endpoint
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/un.h> //dump control socket
+#include <sys/stat.h>
+#endif
+
+//for everything the -finstrument-functions hooks call, so the hooks never re-enter themselves
+#ifdef _MSC_VER
+#define DEBUGGER_NO_INSTRUMENT
+#else
+#define DEBUGGER_NO_INSTRUMENT __attribute__((no_instrument_function))
+#endif
 
 namespace Debugger {
 #pragma region type_name
     //returns the demangled type name of the variable x
     //call `type_name<decltype(x)>()`
     template <class T> std::string type_name() {
-        typedef typename std::remove_reference<T>::type TR;
-        std::unique_ptr<char, void(*)(void*)> own(
+        static const std::string name = [] { //demangled once per type
+            typedef typename std::remove_reference<T>::type TR;
+            std::unique_ptr<char, void(*)(void*)> own(
 #ifndef _MSC_VER
-            abi::__cxa_demangle(typeid(TR).name(), nullptr, nullptr, nullptr),
+                abi::__cxa_demangle(typeid(TR).name(), nullptr, nullptr, nullptr),
 #else
-            nullptr,
+                nullptr,
 #endif
-            std::free);
-        std::string r = own != nullptr ? own.get() : typeid(TR).name();
-        if (std::is_const<TR>::value) r += " const";
-        if (std::is_volatile<TR>::value) r += " volatile";
-        if (std::is_lvalue_reference<T>::value) r += "&";
-        else if (std::is_rvalue_reference<T>::value) r += "&&";
-        return r;
+                std::free);
+            std::string r = own != nullptr ? own.get() : typeid(TR).name();
+            if (std::is_const<TR>::value) r += " const";
+            if (std::is_volatile<TR>::value) r += " volatile";
+            if (std::is_lvalue_reference<T>::value) r += "&";
+            else if (std::is_rvalue_reference<T>::value) r += "&&";
+            return r;
+        }();
+        return name;
     }
 #pragma endregion type_name
 
@@ -43,7 +112,7 @@ namespace Debugger {
 #ifdef _WIN32 //  Windows
     uint64_t clocks() { return __rdtsc(); }
 #else //  Linux/GCC
-    uint64_t clocks() {
+    DEBUGGER_NO_INSTRUMENT inline uint64_t clocks() {
         unsigned int lo, hi;
         __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
         return ((uint64_t)hi << 32) | lo;
@@ -54,14 +123,25 @@ namespace Debugger {
 
     //Benchmarks a function
     template<typename Duration = std::chrono::microseconds, typename F, typename ... Args> typename Duration::rep benchmark(F&& fun, Args&&... args) {
-        const timer beg = { clocks(), std::chrono::high_resolution_clock::now() };
+        const timer beg = { clocks(), std::chrono::steady_clock::now() };
         std::forward<F>(fun)(std::forward<Args>(args)...);
-        return std::chrono::duration_cast<Duration>(std::chrono::high_resolution_clock::now() - beg.second).count();
+        return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - beg.second).count();
     }
 
     //returns a benchmarker object with current clock cycles and time
     inline timer getBench() { return { clocks(), std::chrono::steady_clock::now() }; }
 
+    //clocks() ticks per second, measured once against steady_clock
+    inline double clocksPerSecond() {
+        static const double rate = [] {
+            const timer beg = getBench();
+            timer end = getBench();
+            while (end.second - beg.second < std::chrono::milliseconds(20)) end = getBench();
+            return (end.first - beg.first) / std::chrono::duration<double>(end.second - beg.second).count();
+        }();
+        return rate;
+    }
+
     //prints total clock cycles and nanoseconds since the benchmark passed
     template<typename Duration = std::chrono::microseconds> inline void endBench(timer start) { //fix time output to duration
         std::string type = type_name<Duration>();
@@ -75,27 +155,151 @@ namespace Debugger {
     }
 #pragma endregion timing
 
+#pragma region usage
+    //counters that explain why a region was slow when it was not CPU bound
+    //getUsage() covers the whole process, getThreadUsage() the calling thread's faults and context switches (Linux only, the whole
+    //process on Windows); I/O is always the whole process
+    struct usage {
+        unsigned long long minorFaults, majorFaults; //page faults served without / with disk I/O
+        unsigned long long voluntarySwitches, involuntarySwitches; //blocked vs preempted, not available on Windows
+        unsigned long long readBytes, writeBytes; //storage I/O
+        bool perThread; //taken by getThreadUsage
+    };
+
+#ifndef _MSC_VER
+    //reads a /proc file into buf with plain read() calls and no allocation, so periodic readers (metrics scrapes, live stats)
+    //stay allocation free; returns the length, longer files are cut at size - 1 bytes and the text is always terminated
+    inline size_t readProcFile(const char* path, char* buf, size_t size) {
+        size_t len = 0;
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ssize_t got;
+            while (len + 1 < size && (got = read(fd, buf + len, size - 1 - len)) > 0) len += (size_t)got;
+            close(fd);
+        }
+        buf[len] = 0;
+        return len;
+    }
+
+    //number following key at the start of a line of text, e.g. procField(status, "VmRSS:"), 0 if there is no such line
+    inline unsigned long long procField(const char* text, const char* key) {
+        const size_t n = strlen(key);
+        for (const char* p = text; (p = strstr(p, key)); p += n)
+            if (p == text || p[-1] == '\n') return strtoull(p + n, nullptr, 10);
+        return 0;
+    }
+#endif
+
+    inline usage getUsage(bool perThread = false) {
+        usage u = {};
+        u.perThread = perThread;
+#ifdef _MSC_VER
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) u.minorFaults = pmc.PageFaultCount; //Windows does not split soft and hard faults here
+        IO_COUNTERS io;
+        if (GetProcessIoCounters(GetCurrentProcess(), &io)) {
+            u.readBytes = io.ReadTransferCount;
+            u.writeBytes = io.WriteTransferCount;
+        }
+#else
+        rusage ru;
+        if (!getrusage(perThread ? RUSAGE_THREAD : RUSAGE_SELF, &ru)) {
+            u.minorFaults = ru.ru_minflt;
+            u.majorFaults = ru.ru_majflt;
+            u.voluntarySwitches = ru.ru_nvcsw;
+            u.involuntarySwitches = ru.ru_nivcsw;
+        }
+        char io[1024];
+        readProcFile("/proc/self/io", io, sizeof(io));
+        u.readBytes = procField(io, "read_bytes:");
+        u.writeBytes = procField(io, "write_bytes:");
+#endif
+        return u;
+    }
+
+    //prints the counters accumulated between two snapshots
+    inline void compareUsage(const usage& past, const usage& cur, std::ostream& os = std::cout) {
+        os << "Page faults: " << cur.minorFaults - past.minorFaults << " minor, " << cur.majorFaults - past.majorFaults << " major\nContext switches: "
+            << cur.voluntarySwitches - past.voluntarySwitches << " voluntary, " << cur.involuntarySwitches - past.involuntarySwitches << " involuntary\nI/O: "
+            << cur.readBytes - past.readBytes << " bytes read, " << cur.writeBytes - past.writeBytes << " bytes written\n";
+    }
+
+    //the calling thread's counters, for timing a region without other threads' faults and switches mixed in
+    inline usage getThreadUsage() { return getUsage(true); }
+
+    //prints the counters accumulated since past, re-read the same way past was (process or thread)
+    inline void compareUsage(const usage& past, std::ostream& os = std::cout) { compareUsage(past, getUsage(past.perThread), os); }
+
+    //endBench that also prints the faults, context switches and I/O since past, use with `auto u = getThreadUsage(); auto t = getBench();`
+    template<typename Duration = std::chrono::microseconds> inline void endBench(timer start, const usage& past) {
+        endBench<Duration>(start);
+        compareUsage(past);
+    }
+#pragma endregion usage
+
 #pragma region Memory/CPU
     struct memory {
         unsigned long long virtTotal, virtUsed, virtProg;
-        unsigned long long ramTotal, ramUsed, ramProg;
-        double cpuTotal, cpuProg;
+        unsigned long long ramTotal, ramUsed, ramProg, ramPeak; //ramPeak is the process' high-water mark
+        double cpuTotal, cpuProg; //percent of all processors since the previous reading
+        double cpuSeconds; //user + kernel time consumed by the process so far
+        usage use; //whole process
+        std::chrono::steady_clock::time_point taken;
     };
-#ifdef _MSC_VER
-#include "windows.h"
-#include "psapi.h" //gets info on current process: "process status API"
 
-#include <pdh.h>
-#include <pdhmsg.h>
+    //previous reading behind getCPU()/getSystemCPU()'s "since the previous call"; background readers (exporter, live stats,
+    //hiccup monitor) each own one so they neither race nor eat each other's interval, everything else shares sharedCpuBaseline()
+    struct cpuBaseline {
+        std::mutex lock;
+        double lastCpu = 0; //process CPU seconds
+        std::chrono::steady_clock::time_point lastTime;
+        unsigned long long lastBusy = 0, lastTotal = 0; //system-wide jiffies from /proc/stat, Linux only
+    };
 
-#pragma comment(lib,"pdh.lib")
+    inline cpuBaseline& sharedCpuBaseline() {
+        static cpuBaseline* b = new cpuBaseline(); //intentionally leaked so background threads can still read it during exit
+        return *b;
+    }
 
+    //signed byte count scaled to B/KB/MB/GB
+    inline std::string formatBytes(double bytes) {
+        const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+        int u = 0;
+        while (std::abs(bytes) >= 1024 && u < 4) {
+            bytes /= 1024;
+            ++u;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.1f %s", bytes, units[u]);
+        return buf;
+    }
+#ifdef _MSC_VER
     //cpu stuff
     static PDH_HQUERY cpuQuery;
     static PDH_HCOUNTER cpuTotal;
-    static ULARGE_INTEGER lastCPU, lastSysCPU, lastUserCPU;
     static int numProcessors;
-    static HANDLE self;
+
+    //user + kernel seconds used by this process
+    inline double processCpuSeconds() {
+        FILETIME ftime, fsys, fuser;
+        ULARGE_INTEGER sys, user;
+        GetProcessTimes(GetCurrentProcess(), &ftime, &ftime, &fsys, &fuser);
+        memcpy(&sys, &fsys, sizeof(FILETIME));
+        memcpy(&user, &fuser, sizeof(FILETIME));
+        return (sys.QuadPart + user.QuadPart) / 1e7;
+    }
+
+    //percent of all processors used by this process since the previous call with the same baseline
+    double getCPU(cpuBaseline& b = sharedCpuBaseline()) {
+        std::lock_guard<std::mutex> g(b.lock);
+        const double cpu = processCpuSeconds();
+        const auto now = std::chrono::steady_clock::now();
+        const double wall = std::chrono::duration<double>(now - b.lastTime).count();
+        const double percent = numProcessors > 0 && b.lastTime.time_since_epoch().count() && wall > 0 ? (cpu - b.lastCpu) / wall / numProcessors * 100 : -0.1;
+        b.lastCpu = cpu;
+        b.lastTime = now;
+        return percent;
+    }
 
     void initCPU() {
         PDH_STATUS a = PdhOpenQuery(NULL, NULL, &cpuQuery);
@@ -103,39 +307,13 @@ namespace Debugger {
         PdhCollectQueryData(cpuQuery);
 
         SYSTEM_INFO sysInfo;
-        FILETIME ftime, fsys, fuser;
-
         GetSystemInfo(&sysInfo);
         numProcessors = sysInfo.dwNumberOfProcessors;
-
-        GetSystemTimeAsFileTime(&ftime);
-        memcpy(&lastCPU, &ftime, sizeof(FILETIME));
-
-        self = GetCurrentProcess();
-        GetProcessTimes(self, &ftime, &ftime, &fsys, &fuser);
-        memcpy(&lastSysCPU, &fsys, sizeof(FILETIME));
-        memcpy(&lastUserCPU, &fuser, sizeof(FILETIME));
-    }
-
-    double getCPU() {
-        FILETIME ftime, fsys, fuser;
-        ULARGE_INTEGER now, sys, user;
-
-        GetSystemTimeAsFileTime(&ftime);
-        memcpy(&now, &ftime, sizeof(FILETIME));
-
-        GetProcessTimes(self, &ftime, &ftime, &fsys, &fuser);
-        memcpy(&sys, &fsys, sizeof(FILETIME));
-        memcpy(&user, &fuser, sizeof(FILETIME));
-        double percent = (numProcessors > 0 && now.QuadPart - lastCPU.QuadPart != 0) ? ((((sys.QuadPart - lastSysCPU.QuadPart) + (user.QuadPart - lastUserCPU.QuadPart)) / (now.QuadPart - lastCPU.QuadPart)) / numProcessors) * 100 : -0.1;
-        lastCPU = now;
-        lastUserCPU = user;
-        lastSysCPU = sys;
-
-        return percent;
+        getCPU();
     }
 
-    memory getData() {
+    //the system-wide figure comes from one shared PDH query, only cpuProg is per baseline
+    memory getData(cpuBaseline& b = sharedCpuBaseline()) {
         MEMORYSTATUSEX memInfo;
         memInfo.dwLength = sizeof(MEMORYSTATUSEX);
         GlobalMemoryStatusEx(&memInfo);
@@ -146,14 +324,20 @@ namespace Debugger {
         PdhCollectQueryData(cpuQuery);
         PdhGetFormattedCounterValue(cpuTotal, PDH_FMT_DOUBLE, NULL, &counterVal);
 
-        return { memInfo.ullTotalPageFile, memInfo.ullTotalPageFile - memInfo.ullAvailPageFile, pmc.PrivateUsage, memInfo.ullTotalPhys, memInfo.ullTotalPhys - memInfo.ullAvailPhys, pmc.WorkingSetSize, counterVal.doubleValue, getCPU() };
-    }
-
-    void compareData(memory pastData) {
-        memory curData = getData();
-        std::cout << "Virtual Memory consumption: " << static_cast<long>(curData.virtProg - pastData.virtProg) * 100.f / curData.virtTotal
-            << "%\nRAM consumption: " << static_cast<long>(curData.ramProg - pastData.ramProg) * 100.f / curData.ramTotal << "%\n";
-        if (curData.cpuProg > 0 && pastData.cpuProg > 0) std::cout << "CPU usage: " << curData.cpuProg - pastData.cpuProg << "%\n";
+        memory m;
+        m.virtTotal = memInfo.ullTotalPageFile;
+        m.virtUsed = memInfo.ullTotalPageFile - memInfo.ullAvailPageFile;
+        m.virtProg = pmc.PrivateUsage;
+        m.ramTotal = memInfo.ullTotalPhys;
+        m.ramUsed = memInfo.ullTotalPhys - memInfo.ullAvailPhys;
+        m.ramProg = pmc.WorkingSetSize;
+        m.ramPeak = pmc.PeakWorkingSetSize;
+        m.cpuTotal = counterVal.doubleValue;
+        m.cpuProg = getCPU(b);
+        m.cpuSeconds = processCpuSeconds();
+        m.use = getUsage();
+        m.taken = std::chrono::steady_clock::now();
+        return m;
     }
 
     void printDiag() {
@@ -172,7 +356,3937 @@ namespace Debugger {
         if (counterVal.doubleValue > 0) std::cout << "CPU\n\tUsing: " << getCPU() << "%\n\tSystem using: " << counterVal.doubleValue << "%\n";
     }
 #else
+    //user + kernel seconds used by this process
+    inline double processCpuSeconds() {
+        rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru)) return 0;
+        return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+
+    //percent of all processors used by this process since the previous call with the same baseline
+    inline double getCPU(cpuBaseline& b = sharedCpuBaseline()) {
+        std::lock_guard<std::mutex> g(b.lock);
+        const double cpu = processCpuSeconds();
+        const auto now = std::chrono::steady_clock::now();
+        const double wall = std::chrono::duration<double>(now - b.lastTime).count();
+        const unsigned procs = std::max(1u, std::thread::hardware_concurrency());
+        const double percent = b.lastTime.time_since_epoch().count() && wall > 0 ? (cpu - b.lastCpu) / wall / procs * 100 : -0.1;
+        b.lastCpu = cpu;
+        b.lastTime = now;
+        return percent;
+    }
+
+    //percent of all processors busy system wide since the previous call with the same baseline, from /proc/stat
+    inline double getSystemCPU(cpuBaseline& b = sharedCpuBaseline()) {
+        char text[512]; //only the first line, the aggregate "cpu" one, is needed
+        readProcFile("/proc/stat", text, sizeof(text));
+        char* p = text + strcspn(text, " ");
+        unsigned long long v[8] = {};
+        for (auto& x : v) x = strtoull(p, &p, 10);
+        const unsigned long long idle = v[3] + v[4], total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7], busy = total - idle;
+        std::lock_guard<std::mutex> g(b.lock);
+        const double percent = b.lastTotal && total > b.lastTotal ? (busy - b.lastBusy) * 100.0 / (total - b.lastTotal) : -0.1;
+        b.lastBusy = busy;
+        b.lastTotal = total;
+        return percent;
+    }
+
+    //starts the shared CPU baseline so the first getData() is not measured from boot
+    inline void initCPU() {
+        getCPU();
+        getSystemCPU();
+    }
+
+    //virt* is commit charge (CommitLimit, Committed_AS, VmSize), ram* is physical memory (MemTotal, MemAvailable, VmRSS/VmHWM)
+    //the CPU percentages cover the time since the previous reading with baseline b
+    inline memory getData(cpuBaseline& b = sharedCpuBaseline()) {
+        char sys[4096], proc[4096]; //on the stack, a snapshot never allocates
+        readProcFile("/proc/meminfo", sys, sizeof(sys));
+        readProcFile("/proc/self/status", proc, sizeof(proc));
+        memory m;
+        m.virtTotal = procField(sys, "CommitLimit:") * 1024; //both files are in kB
+        m.virtUsed = procField(sys, "Committed_AS:") * 1024;
+        m.virtProg = procField(proc, "VmSize:") * 1024;
+        m.ramTotal = procField(sys, "MemTotal:") * 1024;
+        m.ramUsed = m.ramTotal - procField(sys, "MemAvailable:") * 1024;
+        m.ramProg = procField(proc, "VmRSS:") * 1024;
+        m.ramPeak = procField(proc, "VmHWM:") * 1024;
+        m.cpuTotal = getSystemCPU(b);
+        m.cpuProg = getCPU(b);
+        m.cpuSeconds = processCpuSeconds();
+        m.use = getUsage();
+        m.taken = std::chrono::steady_clock::now();
+        return m;
+    }
 
+    inline void printDiag() {
+        const memory m = getData();
+        std::cout << "Virtual Memory\n\tUsing: " << m.virtProg * 100.f / m.virtTotal << "% of commit limit.\n\tSystem using: " << m.virtUsed * 100.f / m.virtTotal
+            << "% of total.\nRAM\n\tUsing: " << m.ramProg * 100.f / (m.ramTotal - m.ramUsed) << "% of available.\n\tSystem using: " << m.ramUsed * 100.f / m.ramTotal << "% of total.\n";
+        if (m.cpuTotal > 0) std::cout << "CPU\n\tUsing: " << m.cpuProg << "%\n\tSystem using: " << m.cpuTotal << "%\n";
+    }
 #endif
+
+    //prints the change between two snapshots: absolute growth, growth per second, current vs peak and CPU time used
+    //neither snapshot is re-queried, so e.g. `compareData(before, after)` can be called long after both were taken
+    inline void compareData(const memory& pastData, const memory& curData, std::ostream& os = std::cout) {
+        const double secs = std::chrono::duration<double>(curData.taken - pastData.taken).count();
+        const double virt = (double)curData.virtProg - (double)pastData.virtProg, ram = (double)curData.ramProg - (double)pastData.ramProg;
+        const double cpu = curData.cpuSeconds - pastData.cpuSeconds;
+        os << "Virtual Memory: " << (virt >= 0 ? "+" : "") << formatBytes(virt) << " (" << formatBytes(secs > 0 ? virt / secs : 0) << "/s), now " << formatBytes((double)curData.virtProg)
+            << "\nRAM: " << (ram >= 0 ? "+" : "") << formatBytes(ram) << " (" << formatBytes(secs > 0 ? ram / secs : 0) << "/s), now " << formatBytes((double)curData.ramProg)
+            << ", peak " << formatBytes((double)curData.ramPeak) << "\nCPU: " << cpu << " s over " << secs << " s (" << (secs > 0 ? cpu / secs * 100 : 0) << "% of one core)\n";
+        compareUsage(pastData.use, curData.use, os);
+    }
+
+    //compares pastData against a fresh snapshot
+    inline void compareData(const memory& pastData) { compareData(pastData, getData()); }
 #pragma endregion Memory/CPU 
-}
\ No newline at end of file
+
+#pragma region object_tracking
+    //constructor/assignment/destructor counts for a single type, shared by Tracked<T> and TrackedBase<T>
+    struct objectCounts {
+        std::atomic<uint64_t> defaultCtor{ 0 }, valueCtor{ 0 }, copyCtor{ 0 }, moveCtor{ 0 }, copyAssign{ 0 }, moveAssign{ 0 }, dtor{ 0 };
+    };
+
+    //plain copy of objectCounts so two points in time can be compared
+    struct objectSnapshot {
+        uint64_t defaultCtor, valueCtor, copyCtor, moveCtor, copyAssign, moveAssign, dtor;
+    };
+
+    inline std::mutex& objectRegistryLock() { static std::mutex m; return m; }
+    inline std::map<std::string, objectCounts*>& objectRegistry() { static std::map<std::string, objectCounts*> r; return r; }
+
+    //counts for type T, registered under type_name<T>() on first use
+    template<class T> objectCounts& countsFor() {
+        static objectCounts* counts = [] {
+            std::lock_guard<std::mutex> lock(objectRegistryLock());
+            objectCounts*& slot = objectRegistry()[type_name<T>()];
+            if (!slot) slot = new objectCounts(); //intentionally leaked so counts outlive static destructors
+            return slot;
+        }();
+        return *counts;
+    }
+
+    inline objectSnapshot snapshotOf(const objectCounts& c) {
+        return { c.defaultCtor.load(), c.valueCtor.load(), c.copyCtor.load(), c.moveCtor.load(), c.copyAssign.load(), c.moveAssign.load(), c.dtor.load() };
+    }
+
+    //wraps a value and counts every construction, copy, move, assignment and destruction of it
+    //use `Debugger::Tracked<Big> x;` in place of `Big x;`
+    template<class T> class Tracked {
+        T val;
+    public:
+        Tracked() : val() { ++countsFor<T>().defaultCtor; }
+        template<typename A, typename ... Args, typename = typename std::enable_if<!std::is_same<typename std::decay<A>::type, Tracked>::value>::type>
+        Tracked(A&& a, Args&&... args) : val(std::forward<A>(a), std::forward<Args>(args)...) { ++countsFor<T>().valueCtor; }
+        Tracked(const Tracked& o) : val(o.val) { ++countsFor<T>().copyCtor; }
+        Tracked(Tracked&& o) noexcept(std::is_nothrow_move_constructible<T>::value) : val(std::move(o.val)) { ++countsFor<T>().moveCtor; }
+        Tracked& operator=(const Tracked& o) { val = o.val; ++countsFor<T>().copyAssign; return *this; }
+        Tracked& operator=(Tracked&& o) noexcept(std::is_nothrow_move_assignable<T>::value) { val = std::move(o.val); ++countsFor<T>().moveAssign; return *this; }
+        ~Tracked() { ++countsFor<T>().dtor; }
+
+        T& get() { return val; }
+        const T& get() const { return val; }
+        T& operator*() { return val; }
+        const T& operator*() const { return val; }
+        T* operator->() { return &val; }
+        const T* operator->() const { return &val; }
+        operator T& () { return val; }
+        operator const T& () const { return val; }
+    };
+
+    //opt-in CRTP mixin, counts the special members of Derived through the implicitly generated ones
+    //use `struct Big : Debugger::TrackedBase<Big> { ... };`
+    //a user-written copy/move constructor must call the matching base constructor or it is counted as a default construction
+    template<class Derived> class TrackedBase {
+    protected:
+        TrackedBase() { ++countsFor<Derived>().defaultCtor; }
+        TrackedBase(const TrackedBase&) { ++countsFor<Derived>().copyCtor; }
+        TrackedBase(TrackedBase&&) noexcept { ++countsFor<Derived>().moveCtor; }
+        TrackedBase& operator=(const TrackedBase&) { ++countsFor<Derived>().copyAssign; return *this; }
+        TrackedBase& operator=(TrackedBase&&) noexcept { ++countsFor<Derived>().moveAssign; return *this; }
+        ~TrackedBase() { ++countsFor<Derived>().dtor; }
+    };
+
+    //current counts of every tracked type, keyed by type name
+    inline std::map<std::string, objectSnapshot> getTracked() {
+        std::map<std::string, objectSnapshot> r;
+        std::lock_guard<std::mutex> lock(objectRegistryLock());
+        for (const auto& e : objectRegistry()) r[e.first] = snapshotOf(*e.second);
+        return r;
+    }
+
+    //prints the change in counts for every tracked type since past, skipping types with no activity
+    inline void compareTracked(const std::map<std::string, objectSnapshot>& past, std::ostream& os = std::cout) {
+        for (const auto& e : getTracked()) {
+            objectSnapshot p = {};
+            auto it = past.find(e.first);
+            if (it != past.end()) p = it->second;
+            const objectSnapshot& c = e.second;
+            objectSnapshot d = { c.defaultCtor - p.defaultCtor, c.valueCtor - p.valueCtor, c.copyCtor - p.copyCtor, c.moveCtor - p.moveCtor, c.copyAssign - p.copyAssign, c.moveAssign - p.moveAssign, c.dtor - p.dtor };
+            if (!(d.defaultCtor | d.valueCtor | d.copyCtor | d.moveCtor | d.copyAssign | d.moveAssign | d.dtor)) continue;
+            os << e.first << "\n\tConstructed: " << d.defaultCtor << " default, " << d.valueCtor << " value\n\tCopies: " << d.copyCtor << " constructed, " << d.copyAssign << " assigned"
+                << "\n\tMoves: " << d.moveCtor << " constructed, " << d.moveAssign << " assigned\n\tDestroyed: " << d.dtor << "\n";
+        }
+    }
+
+    //prints the object counts accumulated while it was in scope
+    class trackScope {
+        std::string label;
+        std::map<std::string, objectSnapshot> start;
+    public:
+        explicit trackScope(std::string label = "") : label(std::move(label)), start(getTracked()) {}
+        trackScope(const trackScope&) = delete;
+        trackScope& operator=(const trackScope&) = delete;
+        ~trackScope() {
+            if (!label.empty()) std::cout << "\n" << label << ":\n";
+            compareTracked(start);
+        }
+    };
+#pragma endregion object_tracking
+
+
+#pragma region histogram
+    //index of the highest set bit, v must be non-zero
+    inline int highBit(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanReverse64(&i, v);
+        return (int)i;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    //log-linear histogram of unsigned values, every power of two is split into 8 sub-buckets (~12% resolution)
+    //not synchronised, the owner has to lock or keep one per thread and merge
+    struct histogram {
+        static const int subBits = 3, subCount = 1 << subBits, bucketCount = (64 - subBits + 1) * subCount;
+        uint64_t buckets[bucketCount] = {};
+        uint64_t total = 0, sum = 0, minVal = UINT64_MAX, maxVal = 0;
+
+        static int bucketOf(uint64_t v) {
+            if (v < subCount) return (int)v;
+            const int shift = highBit(v) - subBits;
+            return (shift + 1) * subCount + (int)((v >> shift) & (subCount - 1));
+        }
+        //smallest value that lands in bucket i
+        static uint64_t bucketLow(int i) {
+            if (i < subCount) return (uint64_t)i;
+            const int shift = i / subCount - 1;
+            return (uint64_t)(subCount + i % subCount) << shift;
+        }
+        static uint64_t bucketHigh(int i) { return i < subCount ? (uint64_t)i : bucketLow(i) + ((uint64_t)1 << (i / subCount - 1)) - 1; }
+
+        void record(uint64_t v, uint64_t n = 1) {
+            buckets[bucketOf(v)] += n;
+            total += n;
+            sum += v * n;
+            if (v < minVal) minVal = v;
+            if (v > maxVal) maxVal = v;
+        }
+        void merge(const histogram& o) {
+            for (int i = 0; i < bucketCount; ++i) buckets[i] += o.buckets[i];
+            total += o.total;
+            sum += o.sum;
+            if (o.minVal < minVal) minVal = o.minVal;
+            if (o.maxVal > maxVal) maxVal = o.maxVal;
+        }
+        void reset() { *this = histogram(); }
+
+        uint64_t count() const { return total; }
+        uint64_t min() const { return total ? minVal : 0; }
+        uint64_t max() const { return maxVal; }
+        double mean() const { return total ? (double)sum / total : 0; }
+        //value at quantile p (0..1), accurate to the bucket width
+        uint64_t percentile(double p) const {
+            if (!total) return 0;
+            uint64_t rank = (uint64_t)(p * total + 0.5);
+            if (rank < 1) rank = 1;
+            uint64_t seen = 0;
+            for (int i = 0; i < bucketCount; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    const uint64_t mid = bucketLow(i) + (bucketHigh(i) - bucketLow(i)) / 2;
+                    return mid < minVal ? minVal : mid > maxVal ? maxVal : mid;
+                }
+            }
+            return maxVal;
+        }
+
+        //one line summary, unit is appended to every value
+        void print(std::ostream& os = std::cout, const char* unit = "") const {
+            os << "count: " << total << ", min: " << min() << unit << ", mean: " << (uint64_t)mean() << unit << ", p50: " << percentile(.5) << unit << ", p90: " << percentile(.9) << unit
+                << ", p99: " << percentile(.99) << unit << ", p99.9: " << percentile(.999) << unit << ", max: " << max() << unit << "\n";
+        }
+        //counts grouped by power of two, one line per non-empty range
+        void printDistribution(std::ostream& os = std::cout, const char* unit = "") const {
+            for (int i = 0; i < bucketCount;) {
+                const int end = i < subCount ? i + 1 : (i / subCount + 1) * subCount;
+                uint64_t n = 0;
+                for (int j = i; j < end; ++j) n += buckets[j];
+                if (n) os << "\t[" << bucketLow(i) << unit << ", " << bucketHigh(end - 1) << unit << "]: " << n << "\n";
+                i = end;
+            }
+        }
+    };
+#pragma endregion histogram
+
+#pragma region allocator
+    //allocation statistics for one named container (or group of containers sharing a name)
+    struct allocStats {
+        std::atomic<uint64_t> allocs{ 0 }, frees{ 0 }, bytesAllocated{ 0 }, bytesFreed{ 0 }, growths{ 0 }, current{ 0 }, peak{ 0 };
+        std::mutex sizesLock;
+        histogram sizes;
+
+        void onAlloc(uint64_t bytes) {
+            ++allocs;
+            bytesAllocated += bytes;
+            const uint64_t now = current += bytes;
+            uint64_t top = peak.load(std::memory_order_relaxed);
+            while (now > top && !peak.compare_exchange_weak(top, now)) {}
+            std::lock_guard<std::mutex> lock(sizesLock);
+            sizes.record(bytes);
+        }
+        void onFree(uint64_t bytes) {
+            ++frees;
+            bytesFreed += bytes;
+            current -= bytes;
+        }
+    };
+
+    //plain copy of allocStats so two points in time can be compared
+    struct allocSnapshot {
+        uint64_t allocs, frees, bytesAllocated, bytesFreed, growths, current, peak;
+        histogram sizes;
+    };
+
+    inline std::mutex& allocRegistryLock() { static std::mutex m; return m; }
+    inline std::map<std::string, allocStats*>& allocRegistry() { static std::map<std::string, allocStats*> r; return r; }
+
+    //statistics registered under name, created on first use
+    inline allocStats& allocStatsFor(const std::string& name) {
+        std::lock_guard<std::mutex> lock(allocRegistryLock());
+        allocStats*& slot = allocRegistry()[name];
+        if (!slot) slot = new allocStats(); //intentionally leaked so containers with static lifetime can still free into it
+        return *slot;
+    }
+
+    //allocator adaptor that forwards to Base and records every allocation against a named allocStats
+    //use `std::vector<int, Debugger::CountingAllocator<int>> v(Debugger::CountingAllocator<int>("hot vector"));`
+    template<class T, class Base = std::allocator<T>> class CountingAllocator {
+        template<class U, class B> friend class CountingAllocator;
+        typedef std::allocator_traits<Base> traits;
+        Base base;
+        allocStats* stats;
+        //growth detection for the container holding this instance and every copy or rebind it makes (libstdc++ allocates
+        //hashtable buckets through temporary rebound copies): a free that directly follows a bigger allocation means the
+        //contents were moved to a larger block (vector/string growth, rehash), same-size churn like list nodes never counts
+        std::shared_ptr<std::atomic<size_t>> lastAlloc = std::make_shared<std::atomic<size_t>>(0); //bytes of the latest allocation, 0 once something was freed
+    public:
+        typedef T value_type;
+        typedef typename traits::propagate_on_container_copy_assignment propagate_on_container_copy_assignment;
+        typedef typename traits::propagate_on_container_move_assignment propagate_on_container_move_assignment;
+        typedef typename traits::propagate_on_container_swap propagate_on_container_swap;
+        template<class U> struct rebind { typedef CountingAllocator<U, typename traits::template rebind_alloc<U>> other; };
+
+        CountingAllocator() : stats(&allocStatsFor("unnamed")) {}
+        explicit CountingAllocator(const std::string& name, const Base& base = Base()) : base(base), stats(&allocStatsFor(name)) {}
+        template<class U, class B> CountingAllocator(const CountingAllocator<U, B>& o) : base(o.base), stats(o.stats), lastAlloc(o.lastAlloc) {}
+        //a copied container gets its own growth tracking
+        CountingAllocator select_on_container_copy_construction() const {
+            CountingAllocator c(*this);
+            c.lastAlloc = std::make_shared<std::atomic<size_t>>(0);
+            return c;
+        }
+
+        T* allocate(size_t n) {
+            T* p = traits::allocate(base, n);
+            stats->onAlloc(n * sizeof(T));
+            lastAlloc->store(n * sizeof(T), std::memory_order_relaxed);
+            return p;
+        }
+        void deallocate(T* p, size_t n) {
+            if (lastAlloc->exchange(0, std::memory_order_relaxed) > n * sizeof(T)) ++stats->growths;
+            stats->onFree(n * sizeof(T));
+            traits::deallocate(base, p, n);
+        }
+
+        allocStats& statistics() const { return *stats; }
+        template<class U, class B> bool operator==(const CountingAllocator<U, B>& o) const { return stats == o.stats && base == o.base; }
+        template<class U, class B> bool operator!=(const CountingAllocator<U, B>& o) const { return !(*this == o); }
+    };
+
+    //current statistics of every named container
+    inline std::map<std::string, allocSnapshot> getAllocData() {
+        std::map<std::string, allocSnapshot> r;
+        std::lock_guard<std::mutex> lock(allocRegistryLock());
+        for (const auto& e : allocRegistry()) {
+            allocStats& s = *e.second;
+            allocSnapshot& o = r[e.first];
+            o = { s.allocs.load(), s.frees.load(), s.bytesAllocated.load(), s.bytesFreed.load(), s.growths.load(), s.current.load(), s.peak.load(), histogram() };
+            std::lock_guard<std::mutex> sizesLock(s.sizesLock);
+            o.sizes = s.sizes;
+        }
+        return r;
+    }
+
+    //prints what every named container allocated since past, containers with no activity are skipped
+    //peak is the all-time high, not the peak within the interval
+    inline void compareAllocData(const std::map<std::string, allocSnapshot>& past, std::ostream& os = std::cout) {
+        for (const auto& e : getAllocData()) {
+            const allocSnapshot& c = e.second;
+            auto it = past.find(e.first);
+            const allocSnapshot* p = it != past.end() ? &it->second : nullptr;
+            const uint64_t allocs = c.allocs - (p ? p->allocs : 0);
+            if (!allocs && c.frees == (p ? p->frees : 0)) continue;
+            histogram sizes = c.sizes;
+            if (p) for (int i = 0; i < histogram::bucketCount; ++i) sizes.buckets[i] -= p->sizes.buckets[i];
+            os << e.first << "\n\tAllocations: " << allocs << " (" << c.bytesAllocated - (p ? p->bytesAllocated : 0) << " bytes), frees: " << c.frees - (p ? p->frees : 0)
+                << " (" << c.bytesFreed - (p ? p->bytesFreed : 0) << " bytes)\n\tGrowth reallocations: " << c.growths - (p ? p->growths : 0)
+                << "\n\tHeld: " << c.current << " bytes, peak: " << c.peak << " bytes\n\tRequest sizes:\n";
+            sizes.printDistribution(os, "B");
+        }
+    }
+
+    inline void printAllocData(std::ostream& os = std::cout) { compareAllocData({}, os); }
+#pragma endregion allocator
+
+
+#pragma region machine_profile
+    //pointer-chase latency at one working-set size
+    struct latencyPoint { size_t bytes; double ns, cycles; };
+    //bandwidth of one access pattern, test is "seq read", "seq write", "copy", "random read" or "random write"
+    struct bandwidthPoint { std::string test; unsigned threads; double gbPerSec; };
+
+    struct profileOptions {
+        size_t minBytes = 4 << 10, maxBytes = (size_t)1 << 30; //latency working-set range, two steps per doubling (x1.5, x2)
+        int latencyRepeats = 5; //median of n for every latency point
+        size_t bandwidthBytes = 256 << 20; //buffer used for bandwidth, should be well past the last cache level
+        unsigned threads = 0; //thread count for the multi-threaded bandwidth runs, 0 = hardware concurrency
+        int repeats = 3; //best of n for every bandwidth test
+    };
+
+    //reference numbers for the machine the program runs on, see profileMachine()
+    struct machineProfile {
+        std::vector<latencyPoint> latency;
+        std::vector<size_t> cacheSizes; //largest working set that stayed in each detected level, L1 first
+        double dramLatencyNs = 0;
+        std::vector<bandwidthPoint> bandwidth;
+        std::map<std::string, double> metadata; //flat copy of everything above, e.g. "L2_bytes", "copy_1t_GBps"
+    };
+
+    //average ns per dependent load when chasing a random cycle through bytes of memory, median of repeats runs
+    inline latencyPoint chaseLatency(size_t bytes, size_t steps = 1 << 20, int repeats = 5) {
+        const size_t stride = 64 / sizeof(void*), lines = bytes / 64 < 2 ? 2 : bytes / 64;
+        std::vector<void*> mem(lines * stride);
+        std::vector<size_t> order(lines);
+        for (size_t i = 0; i < lines; ++i) order[i] = i;
+        std::mt19937_64 rng(lines);
+        for (size_t i = lines - 1; i > 0; --i) std::swap(order[i], order[rng() % i]); //Sattolo's shuffle, one cycle through every line
+        for (size_t i = 0; i < lines; ++i) mem[order[i] * stride] = &mem[order[(i + 1) % lines] * stride];
+
+        void* volatile sink = nullptr; //keeps the chase from being optimised away
+        void** p = (void**)mem[0];
+        for (size_t i = 0; i < 2 * lines; ++i) p = (void**)*p; //warm up, two laps so caches and TLB hold what they can
+        std::vector<std::pair<double, double>> runs; //ns, cycles per load
+        for (int r = 0; r < std::max(1, repeats); ++r) {
+            uint64_t cycles = 0;
+            const auto ns = benchmark<std::chrono::nanoseconds>([&] {
+                const uint64_t start = clocks();
+                void** q = p;
+                for (size_t i = 0; i < steps; ++i) q = (void**)*q;
+                sink = q;
+                p = q;
+                cycles = clocks() - start;
+            });
+            runs.push_back({ (double)ns / steps, (double)cycles / steps });
+        }
+        std::sort(runs.begin(), runs.end());
+        const auto& mid = runs[runs.size() / 2];
+        return { bytes, mid.first, mid.second };
+    }
+
+    //GB/s for one access pattern over buf, split evenly between threads
+    inline double measureBandwidth(const std::string& test, std::vector<uint64_t>& buf, std::vector<uint64_t>& dst, unsigned threads, int repeats) {
+        const size_t words = buf.size() / threads, lineWords = 64 / sizeof(uint64_t);
+        std::atomic<uint64_t> sink{ 0 };
+        auto work = [&](unsigned t) {
+            uint64_t* src = buf.data() + t * words, * out = dst.data() + t * words, acc = 0;
+            if (test == "seq read") for (size_t i = 0; i < words; ++i) acc += src[i];
+            else if (test == "seq write") for (size_t i = 0; i < words; ++i) src[i] = i;
+            else if (test == "copy") memcpy(out, src, words * sizeof(uint64_t));
+            else {
+                uint64_t x = 88172645463325252ull + t; //xorshift, one word per random cache line
+                const size_t lines = words / lineWords;
+                const bool write = test == "random write";
+                for (size_t i = 0; i < lines; ++i) {
+                    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                    uint64_t& w = src[(x % lines) * lineWords];
+                    if (write) w = x;
+                    else acc += w;
+                }
+            }
+            sink += acc;
+        };
+        long long best = 0;
+        for (int r = 0; r < repeats; ++r) {
+            const auto ns = benchmark<std::chrono::nanoseconds>([&] {
+                std::vector<std::thread> pool;
+                for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work, t);
+                work(0);
+                for (auto& th : pool) th.join();
+            });
+            if (!best || ns < best) best = ns;
+        }
+        //random tests touch one word per line but the whole line moves, copy reads and writes every byte
+        const double bytes = (double)words * threads * sizeof(uint64_t) * (test == "copy" ? 2 : 1);
+        return best ? bytes / best : 0;
+    }
+
+    //measures load latency from minBytes to maxBytes to find the cache levels, then sequential/random bandwidth
+    //with one thread and with all of them; takes around half a minute at the default sizes
+    inline machineProfile profileMachine(const profileOptions& opt = profileOptions()) {
+        machineProfile prof;
+        for (size_t bytes = opt.minBytes; bytes <= opt.maxBytes; bytes *= 2) {
+            prof.latency.push_back(chaseLatency(bytes, 1 << 20, opt.latencyRepeats));
+            if (bytes + bytes / 2 <= opt.maxBytes) prof.latency.push_back(chaseLatency(bytes + bytes / 2, 1 << 20, opt.latencyRepeats));
+        }
+
+        //a level is a plateau: a run of at least two sizes where each step rises less than 25% and the whole run stays under twice
+        //its first latency (TLB misses make plateaus creep up). The level ends at the plateau's last size, a plateau running to maxBytes is memory
+        for (size_t i = 0; i < prof.latency.size();) {
+            size_t end = i + 1;
+            while (end < prof.latency.size() && prof.latency[end].ns < prof.latency[end - 1].ns * 1.25 && prof.latency[end].ns < prof.latency[i].ns * 2) ++end;
+            if (end - i >= 2 && end < prof.latency.size()) prof.cacheSizes.push_back(prof.latency[end - 1].bytes);
+            i = end;
+        }
+        if (!prof.latency.empty()) prof.dramLatencyNs = prof.latency.back().ns;
+
+        const unsigned all = opt.threads ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<uint64_t> buf(opt.bandwidthBytes / sizeof(uint64_t), 1), dst(buf.size(), 1); //filled so every page is faulted in
+        for (unsigned threads : { 1u, all }) {
+            for (const char* test : { "seq read", "seq write", "copy", "random read", "random write" })
+                prof.bandwidth.push_back({ test, threads, measureBandwidth(test, buf, dst, threads, opt.repeats) });
+            if (all == 1) break;
+        }
+
+        for (size_t i = 0; i < prof.cacheSizes.size(); ++i) prof.metadata["L" + std::to_string(i + 1) + "_bytes"] = (double)prof.cacheSizes[i];
+        prof.metadata["dram_latency_ns"] = prof.dramLatencyNs;
+        prof.metadata["clock_ghz"] = clocksPerSecond() / 1e9;
+        for (const auto& b : prof.bandwidth) {
+            std::string key = b.test;
+            for (char& c : key) if (c == ' ') c = '_';
+            prof.metadata[key + "_" + std::to_string(b.threads) + "t_GBps"] = b.gbPerSec;
+        }
+        return prof;
+    }
+
+    inline void printProfile(const machineProfile& prof, std::ostream& os = std::cout) {
+        os << "Load latency\n";
+        for (const auto& l : prof.latency) os << "\t" << (l.bytes >> 10) << " KB: " << l.ns << " ns, " << l.cycles << " cycles\n";
+        os << "Detected levels\n";
+        for (size_t i = 0; i < prof.cacheSizes.size(); ++i) os << "\tL" << i + 1 << ": " << (prof.cacheSizes[i] >> 10) << " KB\n";
+        os << "\tDRAM: " << prof.dramLatencyNs << " ns\nBandwidth\n";
+        for (const auto& b : prof.bandwidth) os << "\t" << b.test << ", " << b.threads << (b.threads == 1 ? " thread: " : " threads: ") << b.gbPerSec << " GB/s\n";
+    }
+#pragma endregion machine_profile
+
+
+#pragma region core_to_core
+    //CPUs this process may run on
+    inline std::vector<unsigned> allowedCpus() {
+        std::vector<unsigned> cpus;
+#ifdef _WIN32
+        for (unsigned i = 0; i < std::thread::hardware_concurrency(); ++i) cpus.push_back(i);
+#else
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (!sched_getaffinity(0, sizeof(set), &set)) for (unsigned i = 0; i < CPU_SETSIZE; ++i) if (CPU_ISSET(i, &set)) cpus.push_back(i);
+#endif
+        return cpus;
+    }
+
+    //pins the calling thread to one CPU, returns false if the OS refused
+    inline bool pinThread(unsigned cpu) {
+#ifdef _WIN32
+        return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+
+    //latency and TSC offset between every pair of CPUs, n x n row-major in the order of cpus
+    struct coreMatrix {
+        std::vector<unsigned> cpus;
+        std::vector<double> latencyNs; //one-way cache line transfer, half the measured round trip
+        std::vector<double> tscOffset; //clocks() on the column CPU minus clocks() on the row CPU
+        std::vector<double> tscError; //+- bound on the offset, the one-way latency in cycles
+        double at(const std::vector<double>& m, size_t row, size_t col) const { return m[row * cpus.size() + col]; }
+    };
+
+    //runs a(), b() on two threads pinned to cpuA and cpuB and waits for both
+    template<typename A, typename B> void runPinnedPair(unsigned cpuA, unsigned cpuB, A&& a, B&& b) {
+        std::atomic<int> ready{ 0 };
+        std::thread ta([&] { pinThread(cpuA); ++ready; while (ready < 2) {} a(); });
+        std::thread tb([&] { pinThread(cpuB); ++ready; while (ready < 2) {} b(); });
+        ta.join();
+        tb.join();
+    }
+
+    //round trip in cycles of a cache line bounced between cpuA and cpuB, best of a few batches
+    inline double pingPong(unsigned cpuA, unsigned cpuB, int rounds) {
+        struct alignas(64) line { std::atomic<uint64_t> v{ 0 }; };
+        double best = 0;
+        for (int batch = 0; batch < 3; ++batch) {
+            line flag;
+            uint64_t cycles = 0;
+            runPinnedPair(cpuA, cpuB, [&] {
+                const uint64_t start = clocks();
+                for (uint64_t i = 0; i < (uint64_t)rounds; ++i) {
+                    flag.v.store(2 * i + 1, std::memory_order_release);
+                    while (flag.v.load(std::memory_order_acquire) != 2 * i + 2) {}
+                }
+                cycles = clocks() - start;
+            }, [&] {
+                for (uint64_t i = 0; i < (uint64_t)rounds; ++i) {
+                    while (flag.v.load(std::memory_order_acquire) != 2 * i + 1) {}
+                    flag.v.store(2 * i + 2, std::memory_order_release);
+                }
+            });
+            const double rtt = (double)cycles / rounds;
+            if (!batch || rtt < best) best = rtt;
+        }
+        return best;
+    }
+
+    //smallest (receiver clocks() - sender clocks()) seen over rounds messages from cpuA to cpuB
+    inline int64_t minStampDelta(unsigned cpuA, unsigned cpuB, int rounds) {
+        struct alignas(64) line { std::atomic<uint64_t> seq{ 0 }, stamp{ 0 }; };
+        line msg;
+        int64_t best = INT64_MAX;
+        runPinnedPair(cpuA, cpuB, [&] {
+            for (uint64_t i = 0; i < (uint64_t)rounds; ++i) {
+                while (msg.seq.load(std::memory_order_acquire) != 2 * i) {}
+                msg.stamp.store(clocks(), std::memory_order_relaxed);
+                msg.seq.store(2 * i + 1, std::memory_order_release);
+            }
+        }, [&] {
+            for (uint64_t i = 0; i < (uint64_t)rounds; ++i) {
+                while (msg.seq.load(std::memory_order_acquire) != 2 * i + 1) {}
+                const int64_t d = (int64_t)(clocks() - msg.stamp.load(std::memory_order_relaxed));
+                if (d < best) best = d;
+                msg.seq.store(2 * i + 2, std::memory_order_release);
+            }
+        });
+        return best;
+    }
+
+    //measures every pair of allowed CPUs, n*(n-1)/2 pairs so expect a while on large machines
+    //offsets are estimated as half the difference of the best one-way stamp deltas in each direction
+    inline coreMatrix measureCores(int rounds = 5000, std::vector<unsigned> cpus = allowedCpus()) {
+        coreMatrix m;
+        m.cpus = cpus;
+        const size_t n = cpus.size();
+        m.latencyNs.assign(n * n, 0);
+        m.tscOffset.assign(n * n, 0);
+        m.tscError.assign(n * n, 0);
+        const double nsPerClock = 1e9 / clocksPerSecond();
+        for (size_t a = 0; a < n; ++a) {
+            for (size_t b = a + 1; b < n; ++b) {
+                const double lat = pingPong(cpus[a], cpus[b], rounds) / 2 * nsPerClock;
+                const int64_t ab = minStampDelta(cpus[a], cpus[b], rounds), ba = minStampDelta(cpus[b], cpus[a], rounds);
+                const double offset = (ab - ba) / 2.0, err = (ab + ba) / 2.0;
+                m.latencyNs[a * n + b] = m.latencyNs[b * n + a] = lat;
+                m.tscOffset[a * n + b] = offset;
+                m.tscOffset[b * n + a] = -offset;
+                m.tscError[a * n + b] = m.tscError[b * n + a] = err;
+            }
+        }
+        return m;
+    }
+
+    inline void printCoreMatrix(const coreMatrix& m, std::ostream& os = std::cout) {
+        const size_t n = m.cpus.size();
+        auto table = [&](const char* title, const std::vector<double>& v) {
+            os << title << "\n\t";
+            for (unsigned c : m.cpus) os << "\t" << c;
+            os << "\n";
+            for (size_t r = 0; r < n; ++r) {
+                os << "\t" << m.cpus[r];
+                for (size_t c = 0; c < n; ++c) os << "\t" << (r == c ? std::string("-") : std::to_string((long long)(m.at(v, r, c) + (m.at(v, r, c) < 0 ? -0.5 : 0.5))));
+                os << "\n";
+            }
+        };
+        table("Core to core latency (ns)", m.latencyNs);
+        table("TSC offset, column minus row (cycles)", m.tscOffset);
+        double worst = 0, err = 0;
+        for (size_t i = 0; i < m.tscOffset.size(); ++i) {
+            if (std::abs(m.tscOffset[i]) > worst) worst = std::abs(m.tscOffset[i]);
+            if (m.tscError[i] > err) err = m.tscError[i];
+        }
+        os << "Largest TSC offset: " << worst << " cycles (+-" << err << ")\n";
+        os << (worst <= err ? "clocks() deltas taken on different cores agree within measurement error\n" : "clocks() deltas taken on different cores are skewed, keep getBench/endBench on one core\n");
+    }
+#pragma endregion core_to_core
+
+
+#pragma region false_sharing
+    const size_t cacheLineSize = 64;
+
+    //name, offset and size of one declared member, build with DEBUGGER_FIELD(Type, member)
+    struct fieldInfo { std::string name; size_t offset, size; };
+#define DEBUGGER_FIELD(Type, member) Debugger::fieldInfo{ #member, offsetof(Type, member), sizeof(((Type*)nullptr)->member) }
+
+    //cache line index -> names of everything that touches it
+    typedef std::map<uintptr_t, std::vector<std::string>> lineMap;
+
+    //groups fields by the cache lines they cover, base is the object's address or 0 to assume a line-aligned object
+    inline lineMap linesOf(const std::vector<fieldInfo>& fields, uintptr_t base = 0) {
+        lineMap lines;
+        for (const auto& f : fields) {
+            const uintptr_t first = (base + f.offset) / cacheLineSize, last = (base + f.offset + (f.size ? f.size : 1) - 1) / cacheLineSize;
+            for (uintptr_t l = first; l <= last; ++l) lines[l].push_back(f.name);
+        }
+        return lines;
+    }
+
+    //prints every cache line shared by more than one of the fields, returns how many there were
+    //only meaningful for fields written by different threads
+    inline size_t reportSharing(const std::string& title, const lineMap& lines, std::ostream& os = std::cout) {
+        size_t shared = 0;
+        os << title << "\n";
+        for (const auto& l : lines) {
+            if (l.second.size() < 2) continue;
+            ++shared;
+            os << "\tLine 0x" << std::hex << l.first * cacheLineSize << std::dec << ":";
+            for (const auto& n : l.second) os << " " << n;
+            os << "\n";
+        }
+        if (!shared) os << "\tNo shared cache lines\n";
+        return shared;
+    }
+
+    //layout check for declared fields, e.g. reportLayout("worker", { DEBUGGER_FIELD(worker, hits), DEBUGGER_FIELD(worker, misses) })
+    inline size_t reportLayout(const std::string& type, const std::vector<fieldInfo>& fields, const void* object = nullptr, std::ostream& os = std::cout) {
+        return reportSharing(type + (object ? "" : " (assuming a cache line aligned object)"), linesOf(fields, (uintptr_t)object), os);
+    }
+
+    //same check for arbitrary addresses, e.g. one counter per worker
+    inline size_t reportAddresses(const std::vector<std::pair<std::string, const void*>>& addrs, std::ostream& os = std::cout) {
+        std::vector<fieldInfo> fields;
+        for (const auto& a : addrs) fields.push_back({ a.first, (size_t)(uintptr_t)a.second, 1 });
+        return reportSharing("Addresses", linesOf(fields), os);
+    }
+
+    //runtime mode: call recordWrite(&x) next to writes of tracked objects, one in every sampleEvery calls per thread is kept
+    //lines written at different addresses by different threads are reported as false sharing
+    class writeSampler {
+        struct lineWrites { std::map<std::thread::id, uint64_t> threads; std::map<uintptr_t, uint64_t> addrs; };
+        struct object { std::string name; uintptr_t begin, end; };
+        std::mutex lock;
+        std::vector<object> objects;
+        std::map<uintptr_t, lineWrites> lines;
+        unsigned sampleEvery;
+    public:
+        explicit writeSampler(unsigned sampleEvery = 64) : sampleEvery(sampleEvery ? sampleEvery : 1) {}
+
+        void track(const std::string& name, const void* obj, size_t size) {
+            std::lock_guard<std::mutex> g(lock);
+            objects.push_back({ name, (uintptr_t)obj, (uintptr_t)obj + size });
+        }
+        template<typename T> void track(const std::string& name, const T& obj) { track(name, &obj, sizeof(T)); }
+
+        void recordWrite(const void* addr) {
+            thread_local unsigned tick = 0;
+            if (++tick % sampleEvery) return;
+            std::lock_guard<std::mutex> g(lock);
+            lineWrites& l = lines[(uintptr_t)addr / cacheLineSize];
+            ++l.threads[std::this_thread::get_id()];
+            ++l.addrs[(uintptr_t)addr];
+        }
+
+        //lines written by more than one thread, split into false sharing (different addresses) and true sharing
+        size_t report(std::ostream& os = std::cout) {
+            std::lock_guard<std::mutex> g(lock);
+            size_t falseShared = 0;
+            os << "Sampled writes\n";
+            for (const auto& l : lines) {
+                if (l.second.threads.size() < 2) continue;
+                const bool isFalse = l.second.addrs.size() > 1;
+                falseShared += isFalse;
+                os << "\tLine 0x" << std::hex << l.first * cacheLineSize << std::dec << (isFalse ? ": false sharing, " : ": true sharing, ") << l.second.threads.size() << " threads, offsets";
+                for (const auto& a : l.second.addrs) {
+                    os << " " << a.first % cacheLineSize;
+                    for (const auto& o : objects) if (a.first >= o.begin && a.first < o.end) os << " (" << o.name << "+" << a.first - o.begin << ")";
+                }
+                os << "\n";
+            }
+            if (!falseShared) os << "\tNo false sharing seen\n";
+            return falseShared;
+        }
+        void reset() {
+            std::lock_guard<std::mutex> g(lock);
+            lines.clear();
+        }
+    };
+
+    //confirms a suspected layout: one pinned thread per field hammers its field, once in the declared layout and once with
+    //every field on its own line; returns cycles per write packed / padded, well above 1 means the sharing costs real time
+    //returns 0 without measuring when there are fewer allowed CPUs than fields
+    inline double confirmFalseSharing(const std::vector<fieldInfo>& fields, uint64_t writes = 10000000, std::ostream& os = std::cout) {
+        if (fields.empty()) return 0;
+        const std::vector<unsigned> cpus = allowedCpus();
+        //writers sharing a core take turns instead of fighting over the line, the ratio would mean nothing
+        if (cpus.size() < fields.size()) {
+            os << "Contention: needs " << fields.size() << " CPUs for " << fields.size() << " writers, only " << cpus.size() << " allowed, not measured\n";
+            return 0;
+        }
+        size_t span = 0;
+        for (const auto& f : fields) span = std::max(span, f.offset + f.size);
+        auto run = [&](bool padded) {
+            std::vector<char> raw(std::max(span, fields.size() * 2 * cacheLineSize) + cacheLineSize);
+            char* base = raw.data() + (cacheLineSize - (uintptr_t)raw.data() % cacheLineSize) % cacheLineSize;
+            std::atomic<unsigned> ready{ 0 };
+            std::atomic<uint64_t> total{ 0 };
+            std::vector<std::thread> pool;
+            for (size_t t = 0; t < fields.size(); ++t) {
+                volatile char* target = base + (padded ? t * 2 * cacheLineSize : fields[t].offset);
+                pool.emplace_back([&, t, target] {
+                    pinThread(cpus[t]);
+                    ++ready;
+                    while (ready < fields.size()) {}
+                    const uint64_t start = clocks();
+                    for (uint64_t i = 0; i < writes; ++i) *target = *target + 1;
+                    total += clocks() - start;
+                });
+            }
+            for (auto& th : pool) th.join();
+            return (double)total / (writes * fields.size());
+        };
+        const double packed = run(false), padded = run(true), ratio = padded > 0 ? packed / padded : 0;
+        os << "Contention: " << packed << " cycles per write as declared, " << padded << " padded, " << ratio << "x slowdown\n";
+        return ratio;
+    }
+#pragma endregion false_sharing
+
+
+#pragma region lock_profiling
+#define DEBUGGER_STR2(x) #x
+#define DEBUGGER_STR(x) DEBUGGER_STR2(x)
+#define DEBUGGER_CONCAT2(a, b) a##b
+#define DEBUGGER_CONCAT(a, b) DEBUGGER_CONCAT2(a, b)
+    //"file:line" string literal for the current line
+#define DEBUGGER_SITE __FILE__ ":" DEBUGGER_STR(__LINE__)
+    //locks a profiled mutex until the end of the scope and attributes the wait to this line
+#define DEBUGGER_LOCK(m) auto DEBUGGER_CONCAT(debuggerLock, __LINE__) = (m).guard(DEBUGGER_SITE)
+
+    struct lockSiteStats { uint64_t acquisitions = 0, contended = 0, waitCycles = 0; };
+
+    //acquisition statistics for one lock mode, times are in clocks() cycles
+    struct lockStats {
+        uint64_t acquisitions = 0, contended = 0, waitCycles = 0;
+        histogram wait, hold;
+        std::map<std::string, lockSiteStats> sites;
+        std::unordered_map<const char*, lockSiteStats> siteLiterals; //per-thread recording keyed by the DEBUGGER_SITE literal, folded into sites on merge
+
+        void merge(const lockStats& o) {
+            acquisitions += o.acquisitions;
+            contended += o.contended;
+            waitCycles += o.waitCycles;
+            wait.merge(o.wait);
+            hold.merge(o.hold);
+            auto add = [this](const std::string& site, const lockSiteStats& st) {
+                lockSiteStats& d = sites[site];
+                d.acquisitions += st.acquisitions;
+                d.contended += st.contended;
+                d.waitCycles += st.waitCycles;
+            };
+            for (const auto& s : o.sites) add(s.first, s.second);
+            for (const auto& s : o.siteLiterals) add(s.first, s.second);
+        }
+    };
+
+    //a lock the thread holds, recorded when it is taken and turned into statistics once it has been released
+    struct heldLock {
+        const void* lock;
+        uint64_t since, waited; //clocks()
+        const char* site;
+        bool shared, contended;
+    };
+
+    //one thread's statistics for every lock it has taken, keyed by lock name
+    //owned by the thread, guard is only ever contended while a report is being built
+    struct lockThreadData {
+        std::mutex guard;
+        std::map<std::string, std::pair<lockStats, lockStats>> locks; //exclusive, shared
+        std::unordered_map<uint64_t, std::pair<lockStats, lockStats>*> byId; //ProfiledMutex id -> entry in locks, skips the name lookup
+        //the last lock and site recorded, loops usually take the same lock from the same line over and over
+        uint64_t lastId = 0;
+        std::pair<lockStats, lockStats>* last = nullptr;
+        uint64_t lastSiteId = 0;
+        bool lastSiteShared = false;
+        const char* lastSite = nullptr;
+        lockSiteStats* lastSiteStats = nullptr;
+        std::vector<heldLock> held; //owner only, no guard
+        lockThreadData() { held.reserve(16); }
+    };
+
+    struct lockRegistry {
+        std::mutex guard;
+        std::vector<lockThreadData*> live;
+        std::map<std::string, std::pair<lockStats, lockStats>> retired; //merged from threads that have exited
+        bool reportAtExit = true;
+    };
+    inline lockRegistry& locks() {
+        static lockRegistry* r = new lockRegistry(); //leaked so threads exiting during shutdown can still retire into it
+        return *r;
+    }
+
+    //registers the calling thread on first use and merges its numbers into the registry when it exits
+    inline lockThreadData& threadLocks() {
+        struct holder {
+            lockThreadData data;
+            holder() {
+                std::lock_guard<std::mutex> g(locks().guard);
+                locks().live.push_back(&data);
+            }
+            ~holder() {
+                lockRegistry& r = locks();
+                std::lock_guard<std::mutex> g(r.guard);
+                r.live.erase(std::find(r.live.begin(), r.live.end(), &data));
+                for (const auto& l : data.locks) {
+                    r.retired[l.first].first.merge(l.second.first);
+                    r.retired[l.first].second.merge(l.second.second);
+                }
+            }
+        };
+        thread_local holder h;
+        return h.data;
+    }
+
+    //every lock seen so far, exclusive and shared statistics merged over all threads
+    inline std::map<std::string, std::pair<lockStats, lockStats>> getLockData() {
+        lockRegistry& r = locks();
+        std::lock_guard<std::mutex> g(r.guard);
+        auto all = r.retired;
+        for (lockThreadData* t : r.live) {
+            std::lock_guard<std::mutex> tg(t->guard);
+            for (const auto& l : t->locks) {
+                all[l.first].first.merge(l.second.first);
+                all[l.first].second.merge(l.second.second);
+            }
+        }
+        return all;
+    }
+
+    //prints every lock ordered by total wait time, with the top sites by wait
+    inline void reportLocks(std::ostream& os = std::cout, size_t topSites = 5) {
+        auto all = getLockData();
+        std::vector<std::pair<uint64_t, std::string>> order;
+        for (const auto& l : all) order.push_back({ l.second.first.waitCycles + l.second.second.waitCycles, l.first });
+        std::sort(order.rbegin(), order.rend());
+        const double usPerClock = 1e6 / clocksPerSecond();
+        for (const auto& o : order) {
+            os << o.second << "\n";
+            const auto& both = all[o.second];
+            for (int mode = 0; mode < 2; ++mode) {
+                const lockStats& s = mode ? both.second : both.first;
+                if (!s.acquisitions) continue;
+                os << (mode ? "\tShared: " : "\tExclusive: ") << s.acquisitions << " acquisitions, " << s.contended << " contended ("
+                    << s.contended * 100.f / s.acquisitions << "%), waited " << s.waitCycles * usPerClock << " us\n\t\tWait (cycles) ";
+                s.wait.print(os);
+                os << "\t\tHold (cycles) ";
+                s.hold.print(os);
+                std::vector<std::pair<uint64_t, std::string>> sites;
+                for (const auto& site : s.sites) sites.push_back({ site.second.waitCycles, site.first });
+                std::sort(sites.rbegin(), sites.rend());
+                for (size_t i = 0; i < sites.size() && i < topSites; ++i) {
+                    const lockSiteStats& st = s.sites.at(sites[i].second);
+                    os << "\t\t" << sites[i].second << ": " << st.acquisitions << " acquisitions, " << st.contended << " contended, waited " << st.waitCycles * usPerClock << " us\n";
+                }
+            }
+        }
+    }
+
+    //prints reportLocks() when the program exits, unless turned off
+    inline void reportLocksAtExit(bool enabled) { locks().reportAtExit = enabled; }
+
+    //installs the exit report once, called by every profiled mutex
+    inline void scheduleLockReport() {
+        struct reporter { ~reporter() { if (locks().reportAtExit) reportLocks(); } };
+        static reporter r;
+    }
+
+    inline uint64_t nextLockId() {
+        static std::atomic<uint64_t> id{ 0 };
+        return ++id;
+    }
+
+    //wraps a mutex and records acquisitions, wait and hold times per thread, attributed to the calling site when taken through
+    //guard()/DEBUGGER_LOCK, a drop-in for M everywhere else
+    //while the lock is held only a timestamp is pushed, the statistics are updated after the underlying unlock
+    template<class M = std::mutex> class ProfiledMutex {
+    protected:
+        M base;
+        std::string name;
+        uint64_t id = nextLockId(); //unlike the address, never reused by a later mutex
+
+        void acquired(bool shared, bool contended, uint64_t waited, const char* site) {
+            threadLocks().held.push_back({ this, clocks(), waited, site, shared, contended });
+        }
+        //removes this lock from the held list, lock is null if it was not found
+        heldLock releasing() {
+            std::vector<heldLock>& held = threadLocks().held;
+            for (auto it = held.rbegin(); it != held.rend(); ++it) {
+                if (it->lock != this) continue;
+                const heldLock h = *it;
+                held.erase(std::next(it).base());
+                return h;
+            }
+            return heldLock{};
+        }
+        void record(const heldLock& h, uint64_t releasedAt) {
+            if (!h.lock) return;
+            lockThreadData& t = threadLocks();
+            std::lock_guard<std::mutex> g(t.guard);
+            if (t.lastId != id) {
+                std::pair<lockStats, lockStats>*& both = t.byId[id];
+                if (!both) both = &t.locks[name];
+                t.lastId = id;
+                t.last = both;
+            }
+            lockStats& s = h.shared ? t.last->second : t.last->first;
+            ++s.acquisitions;
+            s.contended += h.contended;
+            s.waitCycles += h.waited;
+            s.wait.record(h.waited);
+            s.hold.record(releasedAt - h.since);
+            const char* site = h.site ? h.site : "unknown";
+            if (t.lastSite != site || t.lastSiteId != id || t.lastSiteShared != h.shared) {
+                t.lastSiteStats = &s.siteLiterals[site];
+                t.lastSite = site;
+                t.lastSiteId = id;
+                t.lastSiteShared = h.shared;
+            }
+            lockSiteStats& st = *t.lastSiteStats;
+            ++st.acquisitions;
+            st.contended += h.contended;
+            st.waitCycles += h.waited;
+        }
+    public:
+        explicit ProfiledMutex(std::string name = "") : name(name.empty() ? "mutex " + std::to_string((uintptr_t)this) : std::move(name)) { scheduleLockReport(); }
+        ProfiledMutex(const ProfiledMutex&) = delete;
+        ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+        void lock(const char* site = nullptr) {
+            if (base.try_lock()) return acquired(false, false, 0, site);
+            const uint64_t start = clocks();
+            base.lock();
+            acquired(false, true, clocks() - start, site);
+        }
+        bool try_lock(const char* site = nullptr) {
+            if (!base.try_lock()) return false;
+            acquired(false, false, 0, site);
+            return true;
+        }
+        void unlock() {
+            const uint64_t now = clocks();
+            const heldLock h = releasing();
+            base.unlock();
+            record(h, now);
+        }
+        std::unique_lock<ProfiledMutex> guard(const char* site) {
+            lock(site);
+            return std::unique_lock<ProfiledMutex>(*this, std::adopt_lock);
+        }
+        const std::string& getName() const { return name; }
+    };
+
+    //ProfiledMutex over std::shared_mutex, shared acquisitions are recorded separately
+    class ProfiledSharedMutex : public ProfiledMutex<std::shared_mutex> {
+    public:
+        explicit ProfiledSharedMutex(std::string name = "") : ProfiledMutex<std::shared_mutex>(std::move(name)) {}
+
+        void lock_shared(const char* site = nullptr) {
+            if (base.try_lock_shared()) return acquired(true, false, 0, site);
+            const uint64_t start = clocks();
+            base.lock_shared();
+            acquired(true, true, clocks() - start, site);
+        }
+        bool try_lock_shared(const char* site = nullptr) {
+            if (!base.try_lock_shared()) return false;
+            acquired(true, false, 0, site);
+            return true;
+        }
+        void unlock_shared() {
+            const uint64_t now = clocks();
+            const heldLock h = releasing();
+            base.unlock_shared();
+            record(h, now);
+        }
+        std::unique_lock<ProfiledSharedMutex> guard(const char* site) {
+            lock(site);
+            return std::unique_lock<ProfiledSharedMutex>(*this, std::adopt_lock);
+        }
+        std::shared_lock<ProfiledSharedMutex> sharedGuard(const char* site) {
+            lock_shared(site);
+            return std::shared_lock<ProfiledSharedMutex>(*this, std::adopt_lock);
+        }
+    };
+#pragma endregion lock_profiling
+
+
+#pragma region stack_trace
+#ifdef _MSC_VER
+#define DEBUGGER_NOINLINE __declspec(noinline)
+#else
+#define DEBUGGER_NOINLINE __attribute__((noinline))
+#endif
+
+#ifndef _MSC_VER
+    struct unwindState { void** frames; int max, skip, count; };
+    inline _Unwind_Reason_Code unwindStep(_Unwind_Context* ctx, void* arg) {
+        unwindState* s = (unwindState*)arg;
+        const uintptr_t pc = _Unwind_GetIP(ctx);
+        if (!pc) return _URC_END_OF_STACK;
+        if (s->skip > 0) --s->skip;
+        else if (s->count < s->max) s->frames[s->count++] = (void*)pc;
+        return s->count < s->max ? _URC_NO_REASON : _URC_END_OF_STACK;
+    }
+#endif
+
+    //fills frames with up to max return addresses of the calling thread, innermost first, and returns how many
+    //takes no locks and does not allocate (after primeStackCapture), so it can be used from signal handlers and allocation hooks
+    //define DEBUGGER_FRAME_POINTERS when building with -fno-omit-frame-pointer to walk frame pointers instead of unwind tables
+    DEBUGGER_NOINLINE inline int captureStack(void** frames, int max, int skip = 0) {
+#ifdef _MSC_VER
+        return CaptureStackBackTrace((DWORD)skip + 1, (DWORD)max, frames, nullptr);
+#elif defined(DEBUGGER_FRAME_POINTERS)
+        int count = 0;
+        void** fp = (void**)__builtin_frame_address(0);
+        while (fp && count < max) {
+            void** next = (void**)fp[0];
+            void* ret = fp[1];
+            if (!ret) break;
+            if (skip > 0) --skip;
+            else frames[count++] = ret;
+            //frames only move up the stack, a jump backwards or of more than 1MB means the chain is broken
+            if (next <= fp || (uintptr_t)next - (uintptr_t)fp > (1 << 20) || (uintptr_t)next % sizeof(void*)) break;
+            fp = next;
+        }
+        return count;
+#else
+        unwindState s = { frames, max, skip + 1, 0 };
+        _Unwind_Backtrace(unwindStep, &s);
+        return s.count;
+#endif
+    }
+
+    //the unwinder allocates and takes the loader lock on its first use, call this once at startup before relying on
+    //captureStack from a signal handler
+    inline void primeStackCapture() {
+        static const bool primed = [] {
+            void* frames[4];
+            captureStack(frames, 4);
+            return true;
+        }();
+        (void)primed;
+    }
+
+    //demangled form of a C++ symbol name, results are cached
+    inline std::string demangle(const std::string& name) {
+        static std::mutex lock;
+        static std::unordered_map<std::string, std::string> cache;
+        std::lock_guard<std::mutex> g(lock);
+        auto it = cache.find(name);
+        if (it != cache.end()) return it->second;
+        std::string r = name;
+#ifndef _MSC_VER
+        int status = 0;
+        std::unique_ptr<char, void(*)(void*)> own(abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status), std::free);
+        if (!status && own) r = own.get();
+#endif
+        return cache[name] = r;
+    }
+
+    //maps code addresses to "function+0xoffset (module)", every address is resolved once and cached
+    //on Linux symbols come from the .symtab/.dynsym of every executable mapping in /proc/self/maps, loaded on first use
+    class symbolizer {
+        std::mutex lock;
+        std::unordered_map<uintptr_t, std::string> cache;
+#ifdef _MSC_VER
+        bool ready = false;
+#else
+        struct symbol { uintptr_t addr, size; std::string name; };
+        struct module { uintptr_t start, end, offset, bias; std::string path; std::shared_ptr<std::vector<symbol>> syms; bool loaded; };
+        std::vector<module> modules;
+        std::map<std::string, std::shared_ptr<std::vector<symbol>>> files;
+
+        //function symbols of an ELF file, sorted by address, and the bias that maps the given file offset to start
+        std::shared_ptr<std::vector<symbol>> loadElf(module& m) {
+            auto known = files.find(m.path);
+            auto syms = known != files.end() ? known->second : std::make_shared<std::vector<symbol>>();
+            const int fd = open(m.path.c_str(), O_RDONLY);
+            if (fd < 0) return syms;
+            const off_t len = lseek(fd, 0, SEEK_END);
+            void* map = len > 0 ? mmap(nullptr, (size_t)len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close(fd);
+            if (map == MAP_FAILED) return syms;
+            const char* base = (const char*)map;
+            const Elf64_Ehdr* eh = (const Elf64_Ehdr*)base;
+            if ((size_t)len >= sizeof(Elf64_Ehdr) && !memcmp(eh->e_ident, ELFMAG, SELFMAG) && eh->e_ident[EI_CLASS] == ELFCLASS64) {
+                const Elf64_Phdr* ph = (const Elf64_Phdr*)(base + eh->e_phoff);
+                for (int i = 0; i < eh->e_phnum; ++i) {
+                    if (ph[i].p_type == PT_LOAD && ph[i].p_offset <= m.offset && m.offset < ph[i].p_offset + ph[i].p_filesz) {
+                        m.bias = m.start - (ph[i].p_vaddr + (m.offset - ph[i].p_offset));
+                        break;
+                    }
+                }
+                if (known == files.end()) {
+                    const Elf64_Shdr* sh = (const Elf64_Shdr*)(base + eh->e_shoff);
+                    for (int i = 0; eh->e_shoff && i < eh->e_shnum; ++i) {
+                        if (sh[i].sh_type != SHT_SYMTAB && sh[i].sh_type != SHT_DYNSYM) continue;
+                        const Elf64_Sym* sym = (const Elf64_Sym*)(base + sh[i].sh_offset);
+                        const char* names = base + sh[sh[i].sh_link].sh_offset;
+                        for (size_t j = 0; j < sh[i].sh_size / sizeof(Elf64_Sym); ++j)
+                            if (ELF64_ST_TYPE(sym[j].st_info) == STT_FUNC && sym[j].st_value) syms->push_back({ sym[j].st_value, sym[j].st_size, names + sym[j].st_name });
+                    }
+                    std::sort(syms->begin(), syms->end(), [](const symbol& a, const symbol& b) { return a.addr < b.addr; });
+                    files[m.path] = syms;
+                }
+            }
+            munmap(map, (size_t)len);
+            return syms;
+        }
+
+        std::string resolve(uintptr_t addr) {
+            for (module& m : modules) {
+                if (addr < m.start || addr >= m.end) continue;
+                if (!m.loaded) {
+                    m.syms = loadElf(m);
+                    m.loaded = true;
+                }
+                const uintptr_t rel = addr - m.bias;
+                const std::vector<symbol>& syms = *m.syms;
+                auto it = std::upper_bound(syms.begin(), syms.end(), rel, [](uintptr_t a, const symbol& s) { return a < s.addr; });
+                const std::string file = m.path.substr(m.path.rfind('/') + 1);
+                char buf[32];
+                if (it != syms.begin() && (--it, !it->size || rel < it->addr + it->size)) {
+                    snprintf(buf, sizeof(buf), "+0x%llx (", (unsigned long long)(rel - it->addr));
+                    return demangle(it->name) + buf + file + ")";
+                }
+                snprintf(buf, sizeof(buf), "0x%llx (", (unsigned long long)rel);
+                return buf + file + ")";
+            }
+            char buf[32];
+            snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)addr);
+            return buf;
+        }
+#endif
+    public:
+        //re-reads the loaded modules, needed after dlopen; symbol tables already read are kept
+        void refresh() {
+            std::lock_guard<std::mutex> g(lock);
+            cache.clear();
+#ifndef _MSC_VER
+            modules.clear();
+            std::ifstream maps("/proc/self/maps");
+            std::string line;
+            while (std::getline(maps, line)) {
+                unsigned long long start, end, offset;
+                char perms[8], path[512] = "";
+                if (sscanf(line.c_str(), "%llx-%llx %7s %llx %*s %*s %511s", &start, &end, perms, &offset, path) < 4) continue;
+                if (perms[2] != 'x' || path[0] != '/') continue;
+                modules.push_back({ (uintptr_t)start, (uintptr_t)end, (uintptr_t)offset, 0, path, nullptr, false });
+            }
+#endif
+        }
+
+        std::string symbolize(const void* addr) {
+            std::lock_guard<std::mutex> g(lock);
+            auto it = cache.find((uintptr_t)addr);
+            if (it != cache.end()) return it->second;
+#ifdef _MSC_VER
+            if (!ready) ready = SymInitialize(GetCurrentProcess(), nullptr, TRUE) != FALSE;
+            char buf[sizeof(SYMBOL_INFO) + 256];
+            SYMBOL_INFO* info = (SYMBOL_INFO*)buf;
+            info->SizeOfStruct = sizeof(SYMBOL_INFO);
+            info->MaxNameLen = 255;
+            DWORD64 offset = 0;
+            char hex[32];
+            std::string r;
+            if (ready && SymFromAddr(GetCurrentProcess(), (DWORD64)addr, &offset, info)) {
+                snprintf(hex, sizeof(hex), "+0x%llx", (unsigned long long)offset);
+                r = std::string(info->Name) + hex;
+            }
+            else {
+                snprintf(hex, sizeof(hex), "0x%llx", (unsigned long long)(uintptr_t)addr);
+                r = hex;
+            }
+#else
+            if (modules.empty()) {
+                lock.unlock();
+                refresh();
+                lock.lock();
+            }
+            std::string r = resolve((uintptr_t)addr);
+#endif
+            return cache[(uintptr_t)addr] = r;
+        }
+    };
+
+    inline symbolizer& symbols() {
+        static symbolizer* s = new symbolizer(); //leaked so exit-time reports can still symbolise
+        return *s;
+    }
+
+    //one line per frame, return addresses are looked up one byte back so they land inside the calling instruction
+    inline std::string formatStack(void* const* frames, int count, const char* indent = "\t") {
+        std::string r;
+        for (int i = 0; i < count; ++i) r += indent + symbols().symbolize((char*)frames[i] - 1) + "\n";
+        return r;
+    }
+
+    //prints the calling thread's stack
+    DEBUGGER_NOINLINE inline void printStack(std::ostream& os = std::cout, int maxFrames = 64) {
+        std::vector<void*> frames(maxFrames);
+        os << formatStack(frames.data(), captureStack(frames.data(), maxFrames, 1));
+    }
+#pragma endregion stack_trace
+
+
+#pragma region heap_profiler
+    //allocations and live bytes estimated for one call stack, scaled up from the samples
+    //plus the raw samples behind them, which is what pprof expects as it does its own unsampling
+    struct heapSite {
+        double allocCount = 0, allocBytes = 0, liveCount = 0, liveBytes = 0;
+        uint64_t sampledAllocs = 0, sampledAllocBytes = 0, sampledLive = 0, sampledLiveBytes = 0;
+    };
+    //what one sampled pointer added to its site
+    struct heapSample {
+        double count, bytes;
+        size_t size;
+        heapSite* site;
+    };
+
+    struct heapState {
+        std::mutex lock;
+        std::map<std::vector<void*>, heapSite> sites;
+        std::unordered_map<void*, heapSample> live;
+        std::string exitPath;
+    };
+    inline heapState& heap() {
+        static heapState* h = new heapState(); //leaked so frees during shutdown still find it
+        return *h;
+    }
+
+    //mean bytes between samples, 0 turns sampling off
+    inline std::atomic<uint64_t>& heapSampleInterval() {
+        static std::atomic<uint64_t> interval{ 512 * 1024 };
+        return interval;
+    }
+    inline void setHeapSampleInterval(uint64_t bytes) { heapSampleInterval() = bytes; }
+
+    //set while the profiler itself runs so its own allocations are not sampled
+    inline bool& inHeapHook() {
+        thread_local bool busy = false;
+        return busy;
+    }
+    struct heapHookGuard {
+        bool was;
+        heapHookGuard() : was(inHeapHook()) { inHeapHook() = true; }
+        ~heapHookGuard() { inHeapHook() = was; }
+    };
+
+    //bytes until the next sample, exponentially distributed around the interval so sampling is a Poisson process over bytes
+    inline int64_t nextSampleGap() {
+        thread_local uint64_t x = 0;
+        if (!x) x = ((uint64_t)(uintptr_t)&x ^ clocks()) | 1;
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        const double u = (x >> 11) * (1.0 / 9007199254740992.0);
+        return (int64_t)(-std::log(1 - u) * heapSampleInterval().load(std::memory_order_relaxed)) + 1;
+    }
+
+    //true for the allocations that should be sampled, call for every allocation of size bytes
+    inline bool shouldSampleAlloc(size_t size) {
+        thread_local int64_t until = -1;
+        if (!heapSampleInterval().load(std::memory_order_relaxed) || inHeapHook()) return false;
+        if (until < 0) until = nextSampleGap();
+        until -= (int64_t)size;
+        if (until >= 0) return false;
+        until = nextSampleGap();
+        return true;
+    }
+
+    //records a sampled allocation against the calling stack
+    inline void recordHeapAlloc(void* p, size_t size) {
+        heapHookGuard busy;
+        void* frames[48];
+        const int n = captureStack(frames, 48, 2);
+        //an allocation of size bytes is sampled with probability 1 - e^(-size/interval), weight it back up by that
+        const double interval = (double)heapSampleInterval().load(std::memory_order_relaxed);
+        const double prob = interval > 0 ? 1 - std::exp(-(double)size / interval) : 1;
+        const double count = prob > 0 ? 1 / prob : 1, bytes = size * count;
+        {
+            heapState& h = heap();
+            std::lock_guard<std::mutex> g(h.lock);
+            heapSite& site = h.sites[std::vector<void*>(frames, frames + n)];
+            site.allocCount += count;
+            site.allocBytes += bytes;
+            site.liveCount += count;
+            site.liveBytes += bytes;
+            ++site.sampledAllocs;
+            site.sampledAllocBytes += size;
+            ++site.sampledLive;
+            site.sampledLiveBytes += size;
+            h.live[p] = { count, bytes, size, &site };
+        }
+    }
+
+    //forgets a sampled allocation
+    inline void recordHeapFree(void* p) {
+        heapHookGuard busy;
+        heapState& h = heap();
+        std::lock_guard<std::mutex> g(h.lock);
+        auto it = h.live.find(p);
+        if (it != h.live.end()) {
+            heapSite* site = it->second.site;
+            site->liveCount -= it->second.count;
+            site->liveBytes -= it->second.bytes;
+            --site->sampledLive;
+            site->sampledLiveBytes -= it->second.size;
+            h.live.erase(it);
+        }
+    }
+
+    //writes the sampled heap, either folded stacks ("outer;...;inner bytes", for flamegraph.pl, estimated totals) or the legacy
+    //heap_v2 profile `pprof <binary> <file>` reads (raw samples, pprof scales them up); live bytes unless allocated is set
+    inline void dumpHeapProfile(std::ostream& os, bool pprof = false, bool allocated = false) {
+        heapHookGuard busy; //the report's own allocations stay out of the profile
+        heapState& h = heap();
+        std::map<std::vector<void*>, heapSite> sites;
+        {
+            std::lock_guard<std::mutex> g(h.lock);
+            sites = h.sites;
+        }
+        if (pprof) {
+            heapSite total;
+            for (const auto& s : sites) {
+                total.sampledLive += s.second.sampledLive;
+                total.sampledLiveBytes += s.second.sampledLiveBytes;
+                total.sampledAllocs += s.second.sampledAllocs;
+                total.sampledAllocBytes += s.second.sampledAllocBytes;
+            }
+            os << "heap profile: " << total.sampledLive << ": " << total.sampledLiveBytes << " [" << total.sampledAllocs << ": " << total.sampledAllocBytes << "] @ heap_v2/"
+                << heapSampleInterval().load() << "\n";
+            for (const auto& s : sites) {
+                os << " " << s.second.sampledLive << ": " << s.second.sampledLiveBytes << " [" << s.second.sampledAllocs << ": " << s.second.sampledAllocBytes << "] @";
+                for (void* f : s.first) os << " 0x" << std::hex << (uintptr_t)f << std::dec;
+                os << "\n";
+            }
+#ifndef _MSC_VER
+            os << "\nMAPPED_LIBRARIES:\n" << std::ifstream("/proc/self/maps").rdbuf();
+#endif
+            return;
+        }
+        for (const auto& s : sites) {
+            const double bytes = allocated ? s.second.allocBytes : s.second.liveBytes;
+            if (bytes < .5) continue;
+            for (size_t i = s.first.size(); i-- > 0;) {
+                std::string frame = symbols().symbolize((char*)s.first[i] - 1);
+                for (char& c : frame) if (c == ';') c = ':';
+                os << frame << (i ? ";" : "");
+            }
+            os << " " << (uint64_t)(bytes + .5) << "\n";
+        }
+    }
+
+    //prints the call stacks still holding sampled memory, largest first
+    inline void reportLeaks(std::ostream& os = std::cout, size_t top = 20) {
+        heapHookGuard busy;
+        heapState& h = heap();
+        std::vector<std::pair<heapSite, std::vector<void*>>> sites;
+        {
+            std::lock_guard<std::mutex> g(h.lock);
+            for (const auto& s : h.sites) if (s.second.liveBytes >= .5) sites.push_back({ s.second, s.first });
+        }
+        std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) { return a.first.liveBytes > b.first.liveBytes; });
+        double total = 0;
+        for (const auto& s : sites) total += s.first.liveBytes;
+        os << "Live heap (sampled every ~" << formatBytes((double)heapSampleInterval().load()) << "): " << formatBytes(total) << " in " << sites.size() << " stacks\n";
+        for (size_t i = 0; i < sites.size() && i < top; ++i)
+            os << formatBytes(sites[i].first.liveBytes) << " in ~" << (uint64_t)(sites[i].first.liveCount + .5) << " allocations at\n" << formatStack(sites[i].second.data(), (int)sites[i].second.size());
+    }
+
+    //writes the leak report and a folded profile to path (and path + ".heap" in pprof format) when the program exits
+    inline void heapProfileAtExit(const std::string& path) {
+        struct reporter {
+            ~reporter() {
+                const std::string& path = heap().exitPath;
+                if (path.empty()) return;
+                std::ofstream out(path);
+                reportLeaks(out, SIZE_MAX);
+                out << "\nFolded stacks\n";
+                dumpHeapProfile(out);
+                std::ofstream raw(path + ".heap");
+                dumpHeapProfile(raw, true);
+            }
+        };
+        static reporter r;
+        heap().exitPath = path;
+    }
+#pragma endregion heap_profiler
+
+#pragma region zones
+    //a named region of code, declared once per DEBUGGER_ZONE use and registered so it can be switched on/off or sampled at runtime
+    struct zoneSite {
+        const char* name;
+        const char* file;
+        int line;
+        std::atomic<uint32_t> every{ 1 }; //record one visit in every, 0 = disabled
+        bool on = true; //configured state, every is 0 or rate depending on it, both guarded by zoneControls().guard
+        uint32_t rate = 1;
+        zoneSite(const char* name, const char* file, int line);
+        zoneSite(const zoneSite&) = delete;
+        zoneSite& operator=(const zoneSite&) = delete;
+    };
+
+    //a toggle applied to every zone whose name matches pattern ('*' matches any run of characters), later rules win
+    struct zoneRule {
+        std::string pattern;
+        int on = -1; //-1 = leave as is
+        uint32_t rate = 0; //0 = leave as is
+    };
+    struct zoneControl {
+        std::mutex guard;
+        std::vector<zoneSite*> sites;
+        std::vector<zoneRule> rules;
+    };
+
+    inline bool globMatch(const char* pattern, const char* s) {
+        if (*pattern == '*') return globMatch(pattern + 1, s) || (*s && globMatch(pattern, s + 1));
+        if (!*pattern) return !*s;
+        return *pattern == *s && globMatch(pattern + 1, s + 1);
+    }
+
+    //parses DEBUGGER_ZONES, comma separated "pattern" to enable, "-pattern" to disable and "pattern:N" to record one visit in N
+    //e.g. DEBUGGER_ZONES="-*,net.*,db.query:100"
+    inline std::vector<zoneRule> parseZoneRules(const char* spec) {
+        std::vector<zoneRule> rules;
+        std::string all = spec ? spec : "";
+        for (size_t start = 0; start <= all.size();) {
+            size_t end = all.find(',', start);
+            if (end == std::string::npos) end = all.size();
+            std::string item = all.substr(start, end - start);
+            start = end + 1;
+            if (item.empty()) continue;
+            zoneRule r;
+            if (item[0] == '-') {
+                r.on = 0;
+                item.erase(0, 1);
+            }
+            else r.on = 1;
+            //only a trailing ":<digits>" is a rate, zone names may hold colons themselves (db::query)
+            const size_t colon = item.rfind(':');
+            if (colon != std::string::npos && colon + 1 < item.size() && item.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+                r.rate = (uint32_t)std::max(1L, strtol(item.c_str() + colon + 1, nullptr, 10));
+                item.erase(colon);
+            }
+            r.pattern = item;
+            rules.push_back(r);
+        }
+        return rules;
+    }
+
+    inline zoneControl& zoneControls() {
+        static zoneControl* c = [] {
+            zoneControl* c = new zoneControl(); //leaked, zones may be entered during shutdown
+            c->rules = parseZoneRules(getenv("DEBUGGER_ZONES"));
+            return c;
+        }();
+        return *c;
+    }
+
+    //caller holds zoneControls().guard
+    inline void applyZoneRule(zoneSite& site, const zoneRule& r) {
+        if (!globMatch(r.pattern.c_str(), site.name)) return;
+        if (r.on >= 0) site.on = r.on != 0;
+        if (r.rate) site.rate = r.rate;
+        site.every.store(site.on ? site.rate : 0, std::memory_order_relaxed);
+    }
+
+    inline zoneSite::zoneSite(const char* name, const char* file, int line) : name(name), file(file), line(line) {
+        zoneControl& c = zoneControls();
+        std::lock_guard<std::mutex> g(c.guard);
+        c.sites.push_back(this);
+        for (const zoneRule& r : c.rules) applyZoneRule(*this, r);
+    }
+
+    //adds a rule and applies it to every zone registered so far, zones registered later pick it up when they are first reached
+    inline void setZones(const zoneRule& r) {
+        zoneControl& c = zoneControls();
+        std::lock_guard<std::mutex> g(c.guard);
+        c.rules.push_back(r);
+        for (zoneSite* s : c.sites) applyZoneRule(*s, r);
+    }
+    inline void enableZones(const std::string& pattern, bool on = true) { setZones({ pattern, on ? 1 : 0, 0 }); }
+    //records one visit in every of the matching zones, their counts and times are scaled back up by every in reports
+    inline void sampleZones(const std::string& pattern, uint32_t every) { setZones({ pattern, -1, std::max(1u, every) }); }
+
+    //one line per zone reached so far with its state
+    inline void listZones(std::ostream& os = std::cout) {
+        zoneControl& c = zoneControls();
+        std::lock_guard<std::mutex> g(c.guard);
+        for (const zoneSite* s : c.sites) {
+            os << s->name << " (" << s->file << ":" << s->line << "): " << (s->on ? "on" : "off");
+            if (s->rate > 1) os << ", 1 in " << s->rate;
+            os << "\n";
+        }
+    }
+
+    //true for one visit in every, the generator is per thread so sampling costs no shared writes
+    DEBUGGER_NO_INSTRUMENT inline bool sampleHit(uint32_t every) {
+        thread_local uint64_t x = 0x9e3779b97f4a7c15ull ^ (uint64_t)(uintptr_t)&x;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x % every == 0;
+    }
+
+    //guards against the profiler's own (possibly instrumented) code re-entering the -finstrument-functions hooks
+    DEBUGGER_NO_INSTRUMENT inline bool& inInstrumentHook() {
+        thread_local bool busy = false;
+        return busy;
+    }
+    //keeps the hooks out for a scope, for code that changes the call tree or holds its own thread's trace guard while calling
+    //instrumented code (a hook would lock the same guard again)
+    struct instrumentPause {
+        bool& busy;
+        const bool was;
+        DEBUGGER_NO_INSTRUMENT instrumentPause() : busy(inInstrumentHook()), was(busy) { busy = true; }
+        DEBUGGER_NO_INSTRUMENT ~instrumentPause() { busy = was; }
+        instrumentPause(const instrumentPause&) = delete;
+    };
+
+    //one node of a thread's call tree, keyed by zoneSite* for zones or by function address for instrumented functions
+    //count/cycles are only written by the owning thread, atomics so other threads can read them
+    struct zoneNode {
+        const void* key;
+        bool function;
+        uint32_t parent;
+        std::atomic<uint64_t> count{ 0 }, cycles{ 0 }; //cycles include children
+        std::unordered_map<const void*, uint32_t> children;
+        zoneNode(const void* key, bool function, uint32_t parent) : key(key), function(function), parent(parent) {}
+    };
+
+    //per-thread call tree, guard is taken by the owner only when it adds nodes and by readers while they walk the tree
+    struct threadTrace {
+        std::mutex guard;
+        std::deque<zoneNode> nodes; //node 0 is the thread's root
+        std::vector<std::pair<uint32_t, uint64_t>> stack; //open nodes and the clocks() they were entered at, owner only
+        std::atomic<uint32_t> current{ 0 }; //innermost open node
+        std::vector<std::pair<uint32_t, uint64_t>>* log = nullptr; //zones closed during a LoopMonitor iteration with their cycles, owner only
+        std::string name;
+        threadTrace() { nodes.emplace_back(nullptr, false, 0); }
+    };
+
+    //merged call tree used for reporting
+    struct zoneTotals {
+        const void* key = nullptr;
+        bool function = false;
+        uint64_t count = 0, cycles = 0;
+        std::vector<zoneTotals> children;
+
+        zoneTotals& child(const void* k, bool fn) {
+            for (auto& c : children) if (c.key == k && c.function == fn) return c;
+            children.emplace_back();
+            children.back().key = k;
+            children.back().function = fn;
+            return children.back();
+        }
+        void merge(const zoneTotals& o) {
+            count += o.count;
+            cycles += o.cycles;
+            for (const auto& c : o.children) child(c.key, c.function).merge(c);
+        }
+        std::string name() const {
+            if (!key) return "root";
+            if (!function) return ((const zoneSite*)key)->name;
+            std::string r = symbols().symbolize(key);
+            const size_t at = r.find("+0x0 (");
+            return at == std::string::npos ? r : r.erase(at, 4);
+        }
+        //cycles spent in the node, for nodes that are still open (never exited) the sum of their children
+        uint64_t total() const {
+            if (count) return cycles;
+            uint64_t sum = 0;
+            for (const auto& c : children) sum += c.total();
+            return sum;
+        }
+    };
+
+    struct zoneRegistry {
+        std::mutex guard;
+        std::vector<threadTrace*> threads;
+        zoneTotals retired; //trees of threads that have exited
+        unsigned nextId = 0;
+    };
+    DEBUGGER_NO_INSTRUMENT inline zoneRegistry& zones() {
+        static zoneRegistry* r = new zoneRegistry(); //leaked, threads may exit during shutdown
+        return *r;
+    }
+
+    //copies one thread's tree below node i into out
+    DEBUGGER_NO_INSTRUMENT inline void collectZones(threadTrace& t, uint32_t i, zoneTotals& out) {
+        const zoneNode& n = t.nodes[i];
+        out.count += n.count.load(std::memory_order_relaxed);
+        out.cycles += n.cycles.load(std::memory_order_relaxed);
+        for (const auto& c : n.children) collectZones(t, c.second, out.child(t.nodes[c.second].key, t.nodes[c.second].function));
+    }
+
+    //set after the calling thread's trace has been torn down, zones entered during thread exit are ignored
+    DEBUGGER_NO_INSTRUMENT inline bool& zonesGone() {
+        thread_local bool gone = false;
+        return gone;
+    }
+
+    //the calling thread's trace, registered on first use and merged into the retired totals when the thread exits
+    DEBUGGER_NO_INSTRUMENT inline threadTrace& thisThreadTrace() {
+        struct holder {
+            threadTrace* t = new threadTrace();
+            DEBUGGER_NO_INSTRUMENT holder() {
+                zoneRegistry& r = zones();
+                std::lock_guard<std::mutex> g(r.guard);
+                t->name = "thread " + std::to_string(r.nextId++);
+                r.threads.push_back(t);
+            }
+            DEBUGGER_NO_INSTRUMENT ~holder() {
+                zonesGone() = true;
+                zoneRegistry& r = zones();
+                std::lock_guard<std::mutex> g(r.guard);
+                r.threads.erase(std::find(r.threads.begin(), r.threads.end(), t));
+                collectZones(*t, 0, r.retired);
+                delete t;
+            }
+        };
+        thread_local holder h;
+        return *h.t;
+    }
+
+    //names the calling thread in reports
+    inline void setThreadName(const std::string& name) {
+        threadTrace& t = thisThreadTrace();
+        instrumentPause pause;
+        std::lock_guard<std::mutex> g(t.guard);
+        t.name = name;
+    }
+
+    const size_t maxZoneDepth = 256; //deeper nesting (e.g. deep recursion) is not recorded
+
+    DEBUGGER_NO_INSTRUMENT inline void zoneEnter(const void* key, bool function = false) {
+        if (zonesGone()) return;
+        instrumentPause pause;
+        threadTrace& t = thisThreadTrace();
+        if (t.stack.size() >= maxZoneDepth) return t.stack.push_back({ UINT32_MAX, 0 });
+        const uint32_t parent = t.stack.empty() ? 0 : t.stack.back().first;
+        zoneNode& p = t.nodes[parent];
+        auto it = p.children.find(key);
+        uint32_t i;
+        if (it != p.children.end()) i = it->second;
+        else {
+            std::lock_guard<std::mutex> g(t.guard);
+            i = (uint32_t)t.nodes.size();
+            t.nodes.emplace_back(key, function, parent);
+            p.children[key] = i;
+        }
+        t.stack.push_back({ i, clocks() });
+        t.current.store(i, std::memory_order_relaxed);
+    }
+
+    //closes the innermost zone, visits shorter than minCycles are not counted, a sampled visit stands for weight visits
+    DEBUGGER_NO_INSTRUMENT inline void zoneExit(uint64_t minCycles = 0, uint64_t weight = 1) {
+        if (zonesGone()) return;
+        instrumentPause pause;
+        threadTrace& t = thisThreadTrace();
+        if (t.stack.empty()) return;
+        const auto top = t.stack.back();
+        t.stack.pop_back();
+        if (top.first == UINT32_MAX) return;
+        const uint64_t d = clocks() - top.second;
+        if (t.log) t.log->push_back({ top.first, d });
+        zoneNode& n = t.nodes[top.first];
+        if (d >= minCycles) {
+            n.count.store(n.count.load(std::memory_order_relaxed) + weight, std::memory_order_relaxed);
+            n.cycles.store(n.cycles.load(std::memory_order_relaxed) + d * weight, std::memory_order_relaxed);
+        }
+        t.current.store(n.parent, std::memory_order_relaxed);
+    }
+
+    //sampling state of the calling thread: a visit that is not sampled skips its whole subtree, so nested zones never attach to
+    //the wrong parent, and a sampled visit scales everything recorded below it by its own rate
+    struct zoneSampling {
+        uint32_t skipped = 0; //open zones whose visit was not sampled
+        uint64_t scale = 1; //product of the rates of the open sampled zones
+    };
+    DEBUGGER_NO_INSTRUMENT inline zoneSampling& threadZoneSampling() {
+        thread_local zoneSampling z;
+        return z;
+    }
+
+    //a disabled zone costs one load and branch and is transparent, its children attach to its parent
+    struct zoneScope {
+        uint64_t weight; //0 = disabled
+        uint64_t outerScale = 0; //0 = this visit was not sampled
+        //not instrumented, a hook around the constructor would close the zone it opens
+        DEBUGGER_NO_INSTRUMENT explicit zoneScope(const zoneSite& site) : weight(site.every.load(std::memory_order_relaxed)) { if (weight) enter(site); }
+        zoneScope(const zoneScope&) = delete;
+        zoneScope& operator=(const zoneScope&) = delete;
+        DEBUGGER_NO_INSTRUMENT ~zoneScope() { if (weight) exit(); }
+
+        DEBUGGER_NOINLINE DEBUGGER_NO_INSTRUMENT void enter(const zoneSite& site) {
+            zoneSampling& z = threadZoneSampling();
+            if (z.skipped || (weight > 1 && !sampleHit((uint32_t)weight))) {
+                ++z.skipped;
+                return;
+            }
+            outerScale = z.scale;
+            weight *= outerScale;
+            z.scale = weight;
+            zoneEnter(&site);
+        }
+        DEBUGGER_NOINLINE DEBUGGER_NO_INSTRUMENT void exit() {
+            zoneSampling& z = threadZoneSampling();
+            if (!outerScale) {
+                --z.skipped;
+                return;
+            }
+            zoneExit(0, weight);
+            z.scale = outerScale;
+        }
+    };
+
+    //times the rest of the enclosing scope as a zone called name, nested zones form a per-thread call tree
+    //zones can be switched off or sampled by name with enableZones/sampleZones, DEBUGGER_ZONES or the dump socket's "zone" command
+#define DEBUGGER_ZONE(name) static Debugger::zoneSite DEBUGGER_CONCAT(debuggerZoneSite, __LINE__)(name, __FILE__, __LINE__); \
+    Debugger::zoneScope DEBUGGER_CONCAT(debuggerZone, __LINE__)(DEBUGGER_CONCAT(debuggerZoneSite, __LINE__))
+
+    //call tree of every thread merged together, including threads that have exited
+    inline zoneTotals getZones() {
+        instrumentPause pause;
+        zoneRegistry& r = zones();
+        std::lock_guard<std::mutex> g(r.guard);
+        zoneTotals all = r.retired;
+        for (threadTrace* t : r.threads) {
+            std::lock_guard<std::mutex> tg(t->guard);
+            zoneTotals one;
+            collectZones(*t, 0, one);
+            all.merge(one);
+        }
+        return all;
+    }
+
+    //prints a call tree, children ordered by time, nodes under minShare of their parent are skipped
+    //zones that are still open (e.g. main) have no calls yet and are shown with the time of their children
+    inline void printZones(const zoneTotals& tree, std::ostream& os = std::cout, double minShare = 0, int depth = 0) {
+        std::vector<const zoneTotals*> kids;
+        for (const auto& c : tree.children) if (c.total()) kids.push_back(&c);
+        std::sort(kids.begin(), kids.end(), [](const zoneTotals* a, const zoneTotals* b) { return a->total() > b->total(); });
+        uint64_t parent = tree.count ? tree.cycles : 0;
+        if (!parent) for (const auto* c : kids) parent += c->total();
+        const double msPerClock = 1e3 / clocksPerSecond();
+        for (const auto* c : kids) {
+            const double share = parent ? c->total() * 100.0 / parent : 100;
+            if (share < minShare * 100) continue;
+            os << std::string(depth + 1, '\t') << c->name() << ": ";
+            if (c->count) os << c->count << " calls, " << c->cycles * msPerClock << " ms (" << share << "%), " << c->cycles * msPerClock * 1e3 / c->count << " us avg\n";
+            else os << "open, " << c->total() * msPerClock << " ms in children (" << share << "%)\n";
+            printZones(*c, os, minShare, depth + 1);
+        }
+    }
+    inline void printZones(std::ostream& os = std::cout, double minShare = 0) {
+        os << "Zones\n";
+        printZones(getZones(), os, minShare);
+    }
+
+    //zone path of node i in t from the outermost zone in, the caller holds t.guard
+    inline std::string zonePath(const threadTrace& t, uint32_t i) {
+        std::vector<std::string> names;
+        for (; i && i < t.nodes.size(); i = t.nodes[i].parent) {
+            zoneTotals z;
+            z.key = t.nodes[i].key;
+            z.function = t.nodes[i].function;
+            names.push_back(z.name());
+        }
+        std::string r;
+        for (auto it = names.rbegin(); it != names.rend(); ++it) r += (r.empty() ? "" : " > ") + *it;
+        return r.empty() ? "no zone" : r;
+    }
+#pragma endregion zones
+
+#pragma region instrument_functions
+    //settings for the -finstrument-functions hooks, configure before the instrumented code starts running
+    struct instrumentSettings {
+        std::vector<std::pair<uintptr_t, uintptr_t>> include, exclude; //[begin, end) address ranges, an empty include list allows everything
+        std::atomic<uint64_t> minCycles{ 0 };
+    };
+    DEBUGGER_NO_INSTRUMENT inline instrumentSettings& instrumentation() {
+        static instrumentSettings s;
+        return s;
+    }
+
+    //only functions inside [begin, end) are recorded, may be called several times
+    inline void instrumentOnly(const void* begin, const void* end) { instrumentation().include.push_back({ (uintptr_t)begin, (uintptr_t)end }); }
+    //functions inside [begin, end) are never recorded
+    inline void instrumentExclude(const void* begin, const void* end) { instrumentation().exclude.push_back({ (uintptr_t)begin, (uintptr_t)end }); }
+    //calls shorter than ns are dropped
+    inline void instrumentThreshold(double ns) { instrumentation().minCycles = (uint64_t)(ns * clocksPerSecond() / 1e9); }
+
+    DEBUGGER_NO_INSTRUMENT inline bool instrumentAllowed(const void* fn) {
+        const instrumentSettings& s = instrumentation();
+        const uintptr_t a = (uintptr_t)fn;
+        for (const auto& r : s.exclude) if (a >= r.first && a < r.second) return false;
+        if (s.include.empty()) return true;
+        for (const auto& r : s.include) if (a >= r.first && a < r.second) return true;
+        return false;
+    }
+#pragma endregion instrument_functions
+
+#pragma region ab_compare
+    //regularised incomplete beta function I_x(a, b), continued fraction from Numerical Recipes
+    inline double incompleteBeta(double a, double b, double x) {
+        if (x <= 0) return 0;
+        if (x >= 1) return 1;
+        if (x > (a + 1) / (a + b + 2)) return 1 - incompleteBeta(b, a, 1 - x);
+        const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x)) / a;
+        double c = 1, d = 1 - (a + b) * x / (a + 1);
+        if (std::abs(d) < 1e-300) d = 1e-300;
+        d = 1 / d;
+        double f = d;
+        for (int i = 1; i <= 200; ++i) {
+            for (int odd = 0; odd < 2; ++odd) {
+                const double num = odd ? -(a + i) * (a + b + i) * x / ((a + 2 * i) * (a + 2 * i + 1)) : i * (b - i) * x / ((a + 2 * i - 1) * (a + 2 * i));
+                d = 1 + num * d;
+                if (std::abs(d) < 1e-300) d = 1e-300;
+                c = 1 + num / c;
+                if (std::abs(c) < 1e-300) c = 1e-300;
+                d = 1 / d;
+                f *= c * d;
+            }
+            if (std::abs(c * d - 1) < 1e-12) break;
+        }
+        return front * f;
+    }
+
+    //two-sided p-value of Student's t with df degrees of freedom
+    inline double studentP(double t, double df) { return incompleteBeta(df / 2, .5, df / (df + t * t)); }
+
+    //t such that studentP(t, df) == p
+    inline double studentCritical(double p, double df) {
+        double lo = 0, hi = 1000;
+        for (int i = 0; i < 100; ++i) {
+            const double mid = (lo + hi) / 2;
+            (studentP(mid, df) > p ? lo : hi) = mid;
+        }
+        return (lo + hi) / 2;
+    }
+
+    struct compareResult {
+        size_t runs;
+        double nsA, nsB; //geometric mean time per call
+        double speedup, low, high; //time of A over time of B, >1 means B is faster, with a 95% confidence interval
+        double pValue; //probability of a difference this large if both were equally fast
+        bool outputsEqual; //every run of B returned the same as A and left its arguments the same (non-comparable values are skipped)
+    };
+
+    template<typename T, typename = void> struct isEqualityComparable : std::false_type {};
+    template<typename T> struct isEqualityComparable<T, decltype(void(std::declval<const T&>() == std::declval<const T&>()))> : std::true_type {};
+
+    //copies the original arguments into state (not timed), then calls f on that copy and returns the clocks() the call took,
+    //the result is kept in out when Keep is set
+    template<bool Keep, typename Slot, typename F, typename Tuple> uint64_t timedCall(F& f, std::unique_ptr<Slot>& out, const Tuple& original, std::unique_ptr<Tuple>& state) {
+        state.reset(new Tuple(original));
+        Tuple& args = *state;
+        if constexpr (Keep) {
+            const uint64_t start = clocks();
+            Slot r = std::apply(f, args);
+            const uint64_t end = clocks();
+            out.reset(new Slot(std::move(r)));
+            return end - start;
+        }
+        else {
+            const uint64_t start = clocks();
+            std::apply(f, args);
+            return clocks() - start;
+        }
+    }
+
+    //times implA and implB on the same arguments, interleaved in a random order every round so drift and ordering cancel out,
+    //and tests the per-round log time ratios with a paired t-test
+    //every call gets its own copy of the arguments, made outside the timed region, so implementations that work in place
+    //(e.g. sorts) always start from the original input; arguments must be copyable
+    template<typename A, typename B, typename ... Args> compareResult compareRuns(size_t runs, A&& implA, B&& implB, Args&&... args) {
+        typedef std::tuple<typename std::decay<Args>::type...> Tuple;
+        typedef typename std::decay<decltype(std::apply(implA, std::declval<Tuple&>()))>::type R;
+        constexpr bool keep = !std::is_void<R>::value && isEqualityComparable<R>::value;
+        constexpr bool compareArgs = (isEqualityComparable<typename std::decay<Args>::type>::value && ...);
+        typedef typename std::conditional<keep, R, char>::type Slot;
+        const Tuple original(std::forward<Args>(args)...);
+        std::mt19937_64 rng(clocks());
+        std::vector<double> ratios;
+        double logA = 0, logB = 0;
+        bool equal = true;
+        std::unique_ptr<Slot> outA, outB;
+        std::unique_ptr<Tuple> argsA, argsB; //arguments as each implementation left them
+        timedCall<keep>(implA, outA, original, argsA); //warm up
+        timedCall<keep>(implB, outB, original, argsB);
+        if (runs < 2) runs = 2;
+        for (size_t i = 0; i < runs; ++i) {
+            uint64_t ta, tb;
+            if (rng() & 1) {
+                ta = timedCall<keep>(implA, outA, original, argsA);
+                tb = timedCall<keep>(implB, outB, original, argsB);
+            }
+            else {
+                tb = timedCall<keep>(implB, outB, original, argsB);
+                ta = timedCall<keep>(implA, outA, original, argsA);
+            }
+            if constexpr (keep) if (!(*outA == *outB)) equal = false;
+            if constexpr (compareArgs) if (!(*argsA == *argsB)) equal = false;
+            const double la = std::log((double)(ta ? ta : 1)), lb = std::log((double)(tb ? tb : 1));
+            logA += la;
+            logB += lb;
+            ratios.push_back(la - lb);
+        }
+        const double n = (double)runs;
+        double mean = 0, var = 0;
+        for (double r : ratios) mean += r;
+        mean /= n;
+        for (double r : ratios) var += (r - mean) * (r - mean);
+        var /= n - 1;
+        const double se = std::sqrt(var / n), t = se > 0 ? mean / se : 0, crit = studentCritical(.05, n - 1);
+        const double nsPerClock = 1e9 / clocksPerSecond();
+        return { runs, std::exp(logA / n) * nsPerClock, std::exp(logB / n) * nsPerClock, std::exp(mean), std::exp(mean - crit * se), std::exp(mean + crit * se),
+            se > 0 ? studentP(t, n - 1) : (mean == 0 ? 1 : 0), equal };
+    }
+
+    //compareRuns with 50 rounds
+    template<typename A, typename B, typename ... Args> compareResult compare(A&& implA, B&& implB, Args&&... args) {
+        return compareRuns(50, std::forward<A>(implA), std::forward<B>(implB), std::forward<Args>(args)...);
+    }
+
+    inline void printCompare(const compareResult& r, std::ostream& os = std::cout) {
+        os << "A: " << r.nsA << " ns, B: " << r.nsB << " ns over " << r.runs << " interleaved runs\n";
+        if (r.speedup >= 1) os << "B is " << r.speedup << "x faster (95% CI " << r.low << "x - " << r.high << "x), p = " << r.pValue << "\n";
+        else os << "B is " << 1 / r.speedup << "x slower (95% CI " << 1 / r.high << "x - " << 1 / r.low << "x), p = " << r.pValue << "\n";
+        os << (r.pValue < .05 ? "Difference is significant at 5%\n" : "No significant difference\n");
+        if (!r.outputsEqual) os << "WARNING: outputs differ between A and B\n";
+    }
+#pragma endregion ab_compare
+
+#pragma region auto_tune
+    //processor brand string, e.g. "Intel(R) Xeon(R) Gold 6248 CPU @ 2.50GHz"
+    inline std::string cpuModel() {
+        unsigned regs[12] = {};
+#ifdef _MSC_VER
+        for (int i = 0; i < 3; ++i) __cpuid((int*)regs + i * 4, 0x80000002 + i);
+#else
+        for (unsigned i = 0; i < 3; ++i) __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+#endif
+        char brand[sizeof(regs) + 1] = {};
+        memcpy(brand, regs, sizeof(regs));
+        std::string r = brand;
+        r.erase(0, r.find_first_not_of(' '));
+        return r.empty() ? "unknown cpu" : r;
+    }
+
+    //interchangeable implementations of one operation; on first use the fastest supported one is picked by benchmarking them
+    //with the trial, which calls a variant on representative input it owns (or looked up in cacheFile for this CPU model),
+    //later calls go straight through a function pointer. The caller's own arguments are never used for trial calls.
+    //  static Debugger::autoTuner<void(float*, const float*, size_t)> scale("scale", [](auto f) {
+    //      static std::vector<float> dst(4096), src(4096, 1.f);
+    //      f(dst.data(), src.data(), dst.size());
+    //  });
+    //  scale.add("scalar", scaleScalar).add("avx2", scaleAvx2, hasAvx2);
+    //  scale(dst, src, n);
+    //without a trial the first supported variant is used unless the cache names another one
+    template<typename Sig> class autoTuner;
+    template<typename R, typename ... Args> class autoTuner<R(Args...)> {
+    public:
+        typedef R(*function)(Args...);
+    private:
+        struct variant { std::string name; function f; bool (*supported)(); };
+        std::string op, cacheFile;
+        std::function<void(function)> trial;
+        std::vector<variant> variants;
+        std::atomic<function> chosen{ nullptr };
+        std::string chosenName;
+        std::mutex tuning;
+
+        //cached winner for this CPU and operation, empty if none
+        std::string cached() {
+            std::ifstream in(cacheFile);
+            std::string line, key = cpuModel() + "\t" + op + "\t";
+            while (std::getline(in, line)) if (!line.compare(0, key.size(), key)) return line.substr(key.size());
+            return "";
+        }
+        void store(const std::string& name) {
+            std::vector<std::string> lines;
+            {
+                std::ifstream in(cacheFile);
+                std::string line, key = cpuModel() + "\t" + op + "\t";
+                while (std::getline(in, line)) if (line.compare(0, key.size(), key)) lines.push_back(line);
+                lines.push_back(key + name);
+            }
+            const std::string tmp = cacheFile + ".tmp";
+            {
+                std::ofstream out(tmp, std::ios::trunc);
+                for (const auto& l : lines) out << l << "\n";
+            }
+            std::remove(cacheFile.c_str());
+            std::rename(tmp.c_str(), cacheFile.c_str());
+        }
+        //median ns per trial of f over rounds measurements, each long enough for benchmark() to resolve
+        double measure(function f, int rounds) {
+            size_t reps = 1;
+            while (reps < (1u << 20) && benchmark<std::chrono::nanoseconds>([&] { for (size_t i = 0; i < reps; ++i) trial(f); }) < 50000) reps *= 2;
+            std::vector<double> times;
+            for (int r = 0; r < rounds; ++r) times.push_back((double)benchmark<std::chrono::nanoseconds>([&] { for (size_t i = 0; i < reps; ++i) trial(f); }) / reps);
+            std::sort(times.begin(), times.end());
+            return times[times.size() / 2];
+        }
+    public:
+        explicit autoTuner(std::string op, std::function<void(function)> trial = nullptr, std::string cacheFile = "debugger_tune.txt")
+            : op(std::move(op)), cacheFile(std::move(cacheFile)), trial(std::move(trial)) {}
+
+        //registers an implementation, supported (if given) is checked before it is ever called
+        autoTuner& add(std::string name, function f, bool (*supported)() = nullptr) {
+            std::lock_guard<std::mutex> g(tuning);
+            variants.push_back({ std::move(name), f, supported });
+            return *this;
+        }
+
+        //sets the trial used to time variants, it must call the function it is given on input it owns
+        autoTuner& setTrial(std::function<void(function)> t) {
+            std::lock_guard<std::mutex> g(tuning);
+            trial = std::move(t);
+            return *this;
+        }
+
+        //picks the implementation, ignoring the cache when force is set
+        function tune(bool force = false) {
+            std::lock_guard<std::mutex> g(tuning);
+            if (!force && chosen.load()) return chosen.load();
+            std::vector<const variant*> usable;
+            for (const auto& v : variants) if (!v.supported || v.supported()) usable.push_back(&v);
+            if (usable.empty()) return nullptr;
+            const variant* best = nullptr;
+            const std::string hit = force ? "" : cached();
+            for (const variant* v : usable) if (v->name == hit) best = v;
+            if (!best && !trial) best = usable.front(); //nothing safe to time with, stays untuned and uncached
+            if (!best) {
+                double bestNs = 0;
+                for (const variant* v : usable) {
+                    const double ns = measure(v->f, 9);
+                    if (!best || ns < bestNs) {
+                        best = v;
+                        bestNs = ns;
+                    }
+                }
+                store(best->name);
+            }
+            chosenName = best->name;
+            chosen.store(best->f, std::memory_order_release);
+            return best->f;
+        }
+
+        R operator()(Args... args) {
+            function f = chosen.load(std::memory_order_acquire);
+            if (!f) f = tune();
+            return f(args...);
+        }
+
+        //name of the implementation in use, empty before the first call
+        std::string winner() {
+            std::lock_guard<std::mutex> g(tuning);
+            return chosenName;
+        }
+    };
+#pragma endregion auto_tune
+
+#pragma region throughput
+    //work done by the code being timed, filled in by the benchmark itself through add/setItemsProcessed and add/setBytesProcessed
+    //add* accumulates over every call of the body, set* states what one call of the body does and is multiplied by the call count
+    struct benchCounters {
+        uint64_t items = 0, bytes = 0;
+        uint64_t itemsPerCall = 0, bytesPerCall = 0;
+        //totals for calls runs of the body
+        benchCounters over(uint64_t calls) const {
+            benchCounters t;
+            t.items = items + itemsPerCall * calls;
+            t.bytes = bytes + bytesPerCall * calls;
+            return t;
+        }
+    };
+    inline benchCounters& currentCounters() {
+        thread_local benchCounters c;
+        return c;
+    }
+    inline void addItemsProcessed(uint64_t n) { currentCounters().items += n; }
+    inline void addBytesProcessed(uint64_t n) { currentCounters().bytes += n; }
+    inline void setItemsProcessed(uint64_t n) { currentCounters().itemsPerCall = n; }
+    inline void setBytesProcessed(uint64_t n) { currentCounters().bytesPerCall = n; }
+
+    //elapsed time plus rates derived from the counters, rates are 0 when the matching counter was never set
+    struct throughput {
+        double seconds = 0;
+        uint64_t cycles = 0, items = 0, bytes = 0;
+        double itemsPerSec = 0, gbPerSec = 0, cyclesPerItem = 0, cyclesPerByte = 0;
+    };
+
+    inline throughput makeThroughput(double seconds, uint64_t cycles, const benchCounters& c) {
+        throughput t;
+        t.seconds = seconds;
+        t.cycles = cycles;
+        t.items = c.items;
+        t.bytes = c.bytes;
+        if (seconds > 0) {
+            t.itemsPerSec = c.items / seconds;
+            t.gbPerSec = c.bytes / seconds / 1e9;
+        }
+        if (c.items) t.cyclesPerItem = (double)cycles / c.items;
+        if (c.bytes) t.cyclesPerByte = (double)cycles / c.bytes;
+        return t;
+    }
+
+    //benchmark() that also reports throughput, fun reports its work with add/setItemsProcessed and add/setBytesProcessed
+    //cycles are clocks() ticks, the TSC runs at a fixed rate of clocksPerSecond() regardless of turbo
+    template<typename F, typename ... Args> throughput measureThroughput(F&& fun, Args&&... args) {
+        currentCounters() = benchCounters();
+        uint64_t cycles = 0;
+        const auto ns = benchmark<std::chrono::nanoseconds>([&] {
+            const uint64_t start = clocks();
+            std::forward<F>(fun)(std::forward<Args>(args)...);
+            cycles = clocks() - start;
+        });
+        return makeThroughput(ns / 1e9, cycles, currentCounters().over(1));
+    }
+
+    inline void printThroughput(const throughput& t, std::ostream& os = std::cout) {
+        os << t.seconds * 1e3 << " ms, " << t.cycles << " cycles";
+        if (t.items) os << ", " << t.itemsPerSec << " ops/s, " << t.cyclesPerItem << " cycles/op";
+        if (t.bytes) os << ", " << t.gbPerSec << " GB/s, " << t.cyclesPerByte << " cycles/byte";
+        os << "\n";
+    }
+#pragma endregion throughput
+
+#pragma region benchmark_runner
+    struct benchResult {
+        std::string name;
+        bool ok = true;
+        std::string error; //why the benchmark did not finish, e.g. "killed by signal 11"
+        uint64_t iterations = 0;
+        double nsPerIter = 0, cyclesPerIter = 0;
+        long long ramGrowth = 0; //working set change over the timed runs
+        unsigned long long ramPeak = 0; //high-water mark of the process that ran it
+        throughput rate; //totals over the final timed run, items/bytes as reported by the benchmark
+    };
+
+    struct runOptions {
+        std::string filter; //only run benchmarks whose name contains this
+        uint64_t iterations = 0; //0 = keep doubling until a run takes minSeconds
+        double minSeconds = 0.1;
+        bool isolate = false; //run each benchmark in its own forked process (POSIX only)
+        int cpu = -1; //pin the benchmark to this CPU
+        size_t memoryLimit = 0; //address space limit for isolated runs in bytes, 0 = none
+        double timeoutSeconds = 0; //kill isolated runs that take longer, 0 = no limit
+    };
+
+    inline std::vector<std::pair<std::string, std::function<void()>>>& benchmarks() {
+        static std::vector<std::pair<std::string, std::function<void()>>> list;
+        return list;
+    }
+    inline bool registerBenchmark(std::string name, std::function<void()> fn) {
+        benchmarks().push_back({ std::move(name), std::move(fn) });
+        return true;
+    }
+    //defines and registers a benchmark body, e.g. DEBUGGER_BENCHMARK(parseHeaders) { parse(sample); }
+#define DEBUGGER_BENCHMARK(name) static void name(); static const bool DEBUGGER_CONCAT(name, Registered) = Debugger::registerBenchmark(#name, name); static void name()
+
+    //times fn in the calling process
+    inline benchResult runBenchmark(const std::string& name, const std::function<void()>& fn, const runOptions& opt = runOptions()) {
+        benchResult r;
+        r.name = name;
+        if (opt.cpu >= 0) pinThread((unsigned)opt.cpu);
+        fn(); //warm up
+        const memory before = getData();
+        uint64_t n = opt.iterations ? opt.iterations : 1;
+        for (;;) {
+            currentCounters() = benchCounters();
+            const timer start = getBench();
+            for (uint64_t i = 0; i < n; ++i) fn();
+            const uint64_t cycles = clocks() - start.first;
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start.second).count();
+            if (opt.iterations || secs >= opt.minSeconds || n >= ((uint64_t)1 << 40)) {
+                r.iterations = n;
+                r.nsPerIter = secs * 1e9 / n;
+                r.cyclesPerIter = (double)cycles / n;
+                r.rate = makeThroughput(secs, cycles, currentCounters().over(n));
+                break;
+            }
+            n = secs > 0 ? std::max(n * 2, (uint64_t)(n * opt.minSeconds / secs * 1.2)) : n * 10;
+        }
+        const memory after = getData();
+        r.ramGrowth = (long long)after.ramProg - (long long)before.ramProg;
+        r.ramPeak = after.ramPeak;
+        return r;
+    }
+
+#ifndef _WIN32
+    //runs runBenchmark in a forked child so crashes, leaks and allocator state stay out of the parent and later benchmarks
+    inline benchResult runIsolated(const std::string& name, const std::function<void()>& fn, const runOptions& opt) {
+        benchResult r;
+        r.name = name;
+        int fds[2];
+        if (pipe(fds)) {
+            r.ok = false;
+            r.error = "pipe failed";
+            return r;
+        }
+        std::cout.flush();
+        const pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            r.ok = false;
+            r.error = "fork failed";
+            return r;
+        }
+        if (!pid) {
+            //the child never returns: an exception (e.g. bad_alloc from memoryLimit) must not unwind into the caller's frames
+            char line[256];
+            int len;
+            try {
+                close(fds[0]);
+                if (opt.memoryLimit) {
+                    rlimit lim = { (rlim_t)opt.memoryLimit, (rlim_t)opt.memoryLimit };
+                    setrlimit(RLIMIT_AS, &lim);
+                }
+                const benchResult c = runBenchmark(name, fn, opt);
+                len = snprintf(line, sizeof(line), "%llu %.17g %.17g %lld %llu %.17g %llu %llu %llu\n", (unsigned long long)c.iterations, c.nsPerIter, c.cyclesPerIter, c.ramGrowth, c.ramPeak,
+                    c.rate.seconds, (unsigned long long)c.rate.cycles, (unsigned long long)c.rate.items, (unsigned long long)c.rate.bytes);
+            }
+            catch (const std::exception& e) {
+                len = snprintf(line, sizeof(line), "threw %s\n", e.what());
+                if (write(fds[1], line, (size_t)std::min(len, (int)sizeof(line) - 1))) {} //best effort, the exit status says it failed anyway
+                _exit(3);
+            }
+            catch (...) {
+                _exit(3);
+            }
+            if (write(fds[1], line, (size_t)len) != len) _exit(2);
+            _exit(0);
+        }
+        close(fds[1]);
+        std::string out;
+        char buf[256];
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(opt.timeoutSeconds);
+        bool timedOut = false;
+        for (;;) {
+            pollfd p = { fds[0], POLLIN, 0 };
+            const int wait = opt.timeoutSeconds > 0 ? (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count()) : -1;
+            const int ready = poll(&p, 1, wait);
+            if (!ready) {
+                kill(pid, SIGKILL);
+                timedOut = true;
+                break;
+            }
+            if (ready < 0 && errno == EINTR) continue;
+            const ssize_t got = ready > 0 ? read(fds[0], buf, sizeof(buf)) : -1;
+            if (got <= 0) break;
+            out.append(buf, (size_t)got);
+        }
+        close(fds[0]);
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        unsigned long long iterations = 0, peak = 0, cycles = 0;
+        long long growth = 0;
+        double secs = 0;
+        benchCounters counters;
+        if (timedOut) r.error = "timed out";
+        else if (!out.compare(0, 6, "threw ")) r.error = out.substr(0, out.find('\n'));
+        else if (WIFEXITED(status) && WEXITSTATUS(status) == 3) r.error = "threw an exception";
+        else if (WIFSIGNALED(status)) r.error = "killed by signal " + std::to_string(WTERMSIG(status));
+        else if (!WIFEXITED(status) || WEXITSTATUS(status)) r.error = "exited with status " + std::to_string(WEXITSTATUS(status));
+        else if (sscanf(out.c_str(), "%llu %lf %lf %lld %llu %lf %llu %llu %llu", &iterations, &r.nsPerIter, &r.cyclesPerIter, &growth, &peak, &secs, &cycles,
+            (unsigned long long*)&counters.items, (unsigned long long*)&counters.bytes) != 9) r.error = "no result from child";
+        r.ok = r.error.empty();
+        r.iterations = iterations;
+        r.ramGrowth = growth;
+        r.ramPeak = peak;
+        r.rate = makeThroughput(secs, cycles, counters);
+        return r;
+    }
+#endif
+
+    //runs every registered benchmark that matches opt.filter and prints one line each
+    inline std::vector<benchResult> runBenchmarks(const runOptions& opt = runOptions(), std::ostream& os = std::cout) {
+        std::vector<benchResult> results;
+        for (const auto& b : benchmarks()) {
+            if (!opt.filter.empty() && b.first.find(opt.filter) == std::string::npos) continue;
+#ifdef _WIN32
+            results.push_back(runBenchmark(b.first, b.second, opt)); //no fork on Windows, isolate is ignored
+#else
+            results.push_back(opt.isolate ? runIsolated(b.first, b.second, opt) : runBenchmark(b.first, b.second, opt));
+#endif
+            const benchResult& r = results.back();
+            if (!r.ok) os << r.name << ": FAILED, " << r.error << "\n";
+            else {
+                os << r.name << ": " << r.nsPerIter << " ns, " << r.cyclesPerIter << " cycles per iteration (" << r.iterations << " iterations), RAM "
+                    << (r.ramGrowth >= 0 ? "+" : "") << formatBytes((double)r.ramGrowth) << ", peak " << formatBytes((double)r.ramPeak) << "\n";
+                if (r.rate.items) os << "\t" << r.rate.itemsPerSec << " ops/s, " << r.rate.cyclesPerItem << " cycles/op\n";
+                if (r.rate.bytes) os << "\t" << r.rate.gbPerSec << " GB/s, " << r.rate.cyclesPerByte << " cycles/byte\n";
+            }
+        }
+        return results;
+    }
+#pragma endregion benchmark_runner
+#pragma region load_generator
+    struct loadOptions {
+        double rate = 1000; //requests per second offered to the target
+        double seconds = 1; //length of the arrival schedule
+        int workers = 1; //threads issuing requests, more workers let requests overlap like concurrent clients
+        bool poisson = false; //exponential gaps between arrivals instead of a fixed interval
+        double drainSeconds = 1; //how long past the schedule to keep going before giving up on the rest
+    };
+
+    //latency is measured from the intended start time so that time spent queued behind a slow request is counted (coordinated omission)
+    struct loadResult {
+        uint64_t scheduled = 0, completed = 0, dropped = 0; //dropped = never started before the drain deadline
+        double offeredRate = 0, achievedRate = 0;
+        histogram latency; //ns from intended start to completion, dropped requests count with their wait until the deadline
+        histogram service; //ns from actual start to completion, what a closed loop benchmark would report
+        histogram lag; //ns a request started behind its schedule
+    };
+
+    inline std::vector<uint64_t> arrivalSchedule(const loadOptions& opt) {
+        std::vector<uint64_t> at;
+        if (opt.rate <= 0 || opt.seconds <= 0) return at;
+        const double gap = 1e9 / opt.rate, end = opt.seconds * 1e9;
+        at.reserve((size_t)(opt.rate * opt.seconds) + 1);
+        std::mt19937_64 rng(clocks());
+        std::exponential_distribution<double> exp(1 / gap);
+        for (double t = 0; t < end; t += opt.poisson ? exp(rng) : gap) at.push_back((uint64_t)t);
+        return at;
+    }
+
+    //calls fun(args...) on an open loop schedule and records the latency each request saw
+    template<typename F, typename ... Args> loadResult generateLoad(const loadOptions& opt, F&& fun, Args&&... args) {
+        typedef std::chrono::steady_clock clock;
+        loadResult r;
+        const std::vector<uint64_t> at = arrivalSchedule(opt);
+        r.scheduled = at.size();
+        r.offeredRate = opt.rate;
+        std::atomic<size_t> next{ 0 };
+        std::mutex mtx;
+        const clock::time_point start = clock::now() + std::chrono::milliseconds(1);
+        const clock::time_point deadline = start + std::chrono::nanoseconds((uint64_t)((opt.seconds + opt.drainSeconds) * 1e9));
+        clock::time_point last = start;
+        auto worker = [&] {
+            histogram latency, service, lag;
+            clock::time_point done = start;
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < at.size();) {
+                const clock::time_point intended = start + std::chrono::nanoseconds(at[i]);
+                clock::time_point now = clock::now();
+                if (now < intended) {
+                    //sleep most of the way, then spin so the scheduler's wake-up slack is not charged to the target
+                    if (intended - now > std::chrono::microseconds(200)) std::this_thread::sleep_until(intended - std::chrono::microseconds(100));
+                    while ((now = clock::now()) < intended) {}
+                }
+                else if (now >= deadline) {
+                    next.store(at.size(), std::memory_order_relaxed);
+                    break;
+                }
+                fun(args...);
+                done = clock::now();
+                latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+                service.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(done - now).count());
+                lag.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - intended).count());
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            r.latency.merge(latency);
+            r.service.merge(service);
+            r.lag.merge(lag);
+            if (done > last) last = done;
+        };
+        std::vector<std::thread> threads;
+        for (int i = 1; i < opt.workers; ++i) threads.emplace_back(worker);
+        worker();
+        for (auto& t : threads) t.join();
+        r.completed = r.latency.count();
+        r.dropped = r.scheduled - r.completed;
+        //requests that never ran waited at least until the deadline, leaving them out would hide exactly the overload we are looking for
+        //requests are claimed in schedule order so the ones left over are the latest
+        for (size_t i = (size_t)r.completed; i < at.size(); ++i)
+            r.latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - (start + std::chrono::nanoseconds(at[i]))).count());
+        const double elapsed = std::chrono::duration<double>(last - start).count();
+        if (elapsed > 0) r.achievedRate = r.completed / elapsed;
+        return r;
+    }
+
+    inline void printLoad(const loadResult& r, std::ostream& os = std::cout) {
+        os << "offered " << r.offeredRate << "/s, achieved " << r.achievedRate << "/s, " << r.completed << "/" << r.scheduled << " completed";
+        if (r.dropped) os << ", " << r.dropped << " dropped";
+        os << "\nlatency (from intended start): ";
+        r.latency.print(os, "ns");
+        os << "service time: ";
+        r.service.print(os, "ns");
+        os << "start lag: ";
+        r.lag.print(os, "ns");
+    }
+#pragma endregion load_generator
+#pragma region scalability
+    struct scalingPoint {
+        int threads = 0;
+        double opsPerSec = 0;
+        double speedup = 0; //throughput relative to one thread
+    };
+
+    //Universal Scalability Law C(N) = N / (1 + alpha (N-1) + beta N (N-1)) and Amdahl C(N) = N / (1 + serial (N-1)) fitted to the sweep
+    struct scalingResult {
+        std::vector<scalingPoint> points;
+        double alpha = 0; //contention, the share of work that queues for a shared resource
+        double beta = 0; //coherency, the cost of keeping every pair of threads in sync (cache lines bouncing, crosstalk)
+        double serialFraction = 0; //Amdahl fit, ignores coherency
+        double peakThreads = INFINITY; //where USL throughput tops out, sqrt((1 - alpha) / beta)
+        double peakSpeedup = INFINITY;
+        double knee = INFINITY; //threads at which each one only adds half its worth (efficiency C(N)/N = 50%)
+    };
+
+    inline double uslSpeedup(double n, double alpha, double beta) { return n / (1 + alpha * (n - 1) + beta * n * (n - 1)); }
+
+    //least squares fit of the linearised USL, N/C(N) - 1 = alpha (N-1) + beta N (N-1)
+    inline void fitScaling(scalingResult& r) {
+        double xx = 0, xz = 0, zz = 0, xy = 0, zy = 0;
+        for (const scalingPoint& p : r.points) {
+            if (p.speedup <= 0) continue;
+            const double x = p.threads - 1., z = (double)p.threads * (p.threads - 1), y = p.threads / p.speedup - 1;
+            xx += x * x; xz += x * z; zz += z * z; xy += x * y; zy += z * y;
+        }
+        //fractions of the work, retrograde scaling (slower with more threads) would otherwise push them past 1
+        r.serialFraction = xx > 0 ? std::min(1., std::max(0., xy / xx)) : 0;
+        const double det = xx * zz - xz * xz;
+        r.alpha = det > 0 ? (xy * zz - zy * xz) / det : 0;
+        r.beta = det > 0 ? (zy * xx - xy * xz) / det : 0;
+        //a negative coefficient has no physical meaning, refit with the other one alone
+        if (r.beta < 0 || det <= 0) { r.beta = 0; r.alpha = r.serialFraction; }
+        else if (r.alpha < 0) { r.alpha = 0; r.beta = zz > 0 ? std::max(0., zy / zz) : 0; }
+        //everything queues, the rest of the slowdown is coherency: refit beta to y - (N-1)
+        if (r.alpha > 1) { r.alpha = 1; r.beta = zz > 0 ? std::max(0., (zy - xz) / zz) : 0; }
+
+        r.peakThreads = r.peakSpeedup = r.knee = INFINITY;
+        if (r.beta > 0) {
+            //when contention alone eats the gain of a second thread the best is a single one
+            const double q = (1 - r.alpha) / r.beta;
+            r.peakThreads = q > 1 ? std::sqrt(q) : 1;
+            r.peakSpeedup = uslSpeedup(r.peakThreads, r.alpha, r.beta);
+            //alpha (N-1) + beta N (N-1) = 1
+            const double b = r.alpha - r.beta, c = -(r.alpha + 1);
+            r.knee = (-b + std::sqrt(b * b - 4 * r.beta * c)) / (2 * r.beta);
+        }
+        else if (r.alpha > 0) {
+            r.peakSpeedup = 1 / r.alpha;
+            r.knee = 1 + 1 / r.alpha;
+        }
+    }
+
+    //runs fun(threadIndex) in a loop on 1..maxThreads threads for `seconds` each and fits the scalability models to the throughput
+    //one call counts as one operation unless the body reports its own count with add/setItemsProcessed
+    template<typename F> scalingResult sweepConcurrency(F&& fun, int maxThreads = 0, double seconds = 0.5) {
+        if (maxThreads <= 0) maxThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+        scalingResult r;
+        for (int n = 1; n <= maxThreads; ++n) {
+            std::atomic<int> ready{ 0 };
+            std::atomic<bool> go{ false }, stop{ false };
+            std::atomic<uint64_t> ops{ 0 };
+            auto worker = [&](int index) {
+                currentCounters() = benchCounters();
+                uint64_t calls = 0;
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {}
+                while (!stop.load(std::memory_order_relaxed)) {
+                    fun(index);
+                    ++calls;
+                }
+                const benchCounters done = currentCounters().over(calls);
+                ops.fetch_add(done.items ? done.items : calls);
+            };
+            std::vector<std::thread> threads;
+            for (int i = 0; i < n; ++i) threads.emplace_back(worker, i);
+            while (ready.load() < n) std::this_thread::yield();
+            const timer start = getBench();
+            go.store(true, std::memory_order_release);
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            stop.store(true);
+            for (auto& t : threads) t.join();
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start.second).count();
+            scalingPoint p;
+            p.threads = n;
+            p.opsPerSec = ops.load() / secs;
+            p.speedup = r.points.empty() ? 1 : p.opsPerSec / r.points[0].opsPerSec;
+            r.points.push_back(p);
+        }
+        fitScaling(r);
+        return r;
+    }
+
+    inline void printScaling(const scalingResult& r, std::ostream& os = std::cout) {
+        os << "threads\tops/s\tspeedup\tUSL\n";
+        for (const scalingPoint& p : r.points) os << p.threads << "\t" << p.opsPerSec << "\t" << p.speedup << "\t" << uslSpeedup(p.threads, r.alpha, r.beta) << "\n";
+        os << "contention alpha: " << r.alpha << ", coherency beta: " << r.beta << ", Amdahl serial fraction: " << r.serialFraction << "\n";
+        os << "predicted peak: " << r.peakSpeedup << "x at " << r.peakThreads << " threads, knee (50% efficiency) at " << r.knee << " threads\n";
+    }
+#pragma endregion scalability
+#pragma region metrics
+    //always-on named metrics, e.g. `static Debugger::Counter requests("http_requests");` then `requests.inc();`
+    //counters and histograms write to a cache-line sized shard owned by the calling thread so the hot path never shares a line,
+    //readers sum the shards when a snapshot is taken
+    enum class metricKind { counter, gauge, histogram };
+
+    struct metricHistShard {
+        std::atomic<uint64_t> buckets[histogram::bucketCount];
+        std::atomic<uint64_t> total{ 0 }, sum{ 0 }, minVal{ UINT64_MAX }, maxVal{ 0 };
+        metricHistShard() { for (auto& b : buckets) b.store(0, std::memory_order_relaxed); }
+        void addTo(histogram& h) const {
+            for (int i = 0; i < histogram::bucketCount; ++i) h.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+            h.total += total.load(std::memory_order_relaxed);
+            h.sum += sum.load(std::memory_order_relaxed);
+            h.minVal = std::min(h.minVal, minVal.load(std::memory_order_relaxed));
+            h.maxVal = std::max(h.maxVal, maxVal.load(std::memory_order_relaxed));
+        }
+    };
+
+    //only the owning thread writes a shard, so updates are a plain load and store instead of a locked read-modify-write
+    struct alignas(64) metricShard {
+        std::atomic<uint64_t> value{ 0 };
+        std::atomic<metricHistShard*> hist{ nullptr };
+    };
+
+    static const size_t metricPageSize = 64, maxMetricPages = 256; //up to 16384 metrics
+
+    struct metricThreadData {
+        std::atomic<metricShard*> pages[maxMetricPages] = {};
+    };
+
+    struct metricInfo {
+        std::string name, help;
+        metricKind kind;
+        std::atomic<double> gauge{ 0 };
+        metricInfo(std::string n, std::string h, metricKind k) : name(std::move(n)), help(std::move(h)), kind(k) {}
+    };
+
+    struct metricRegistry {
+        std::mutex guard;
+        std::deque<metricInfo> infos; //deque so gauges keep their address as metrics are added
+        std::unordered_map<std::string, size_t> ids;
+        std::vector<metricThreadData*> live;
+        std::vector<uint64_t> retired; //counter totals from threads that have exited, by id
+        std::map<size_t, histogram> retiredHists;
+    };
+    inline metricRegistry& metrics() {
+        static metricRegistry* r = new metricRegistry(); //leaked so threads exiting during shutdown can still retire into it
+        return *r;
+    }
+
+    //id of the metric called name, registering it on first use
+    inline size_t metricId(const std::string& name, metricKind kind, const std::string& help) {
+        metricRegistry& r = metrics();
+        std::lock_guard<std::mutex> g(r.guard);
+        auto it = r.ids.find(name);
+        if (it != r.ids.end()) return it->second;
+        r.infos.emplace_back(name, help, kind);
+        r.retired.push_back(0);
+        return r.ids[name] = r.infos.size() - 1;
+    }
+
+    inline metricThreadData& threadMetrics() {
+        struct holder {
+            metricThreadData data;
+            holder() {
+                std::lock_guard<std::mutex> g(metrics().guard);
+                metrics().live.push_back(&data);
+            }
+            ~holder() {
+                metricRegistry& r = metrics();
+                std::lock_guard<std::mutex> g(r.guard);
+                r.live.erase(std::find(r.live.begin(), r.live.end(), &data));
+                for (size_t p = 0; p < maxMetricPages; ++p) {
+                    metricShard* page = data.pages[p].load(std::memory_order_relaxed);
+                    if (!page) continue;
+                    for (size_t i = 0; i < metricPageSize; ++i) {
+                        const size_t id = p * metricPageSize + i;
+                        if (id < r.retired.size()) r.retired[id] += page[i].value.load(std::memory_order_relaxed);
+                        if (metricHistShard* h = page[i].hist.load(std::memory_order_relaxed)) {
+                            h->addTo(r.retiredHists[id]);
+                            delete h;
+                        }
+                    }
+                    delete[] page;
+                }
+            }
+        };
+        thread_local holder h;
+        return h.data;
+    }
+
+    //the calling thread's shard for metric id, nullptr past the metric limit
+    inline metricShard* metricShardFor(size_t id) {
+        const size_t p = id / metricPageSize;
+        if (p >= maxMetricPages) return nullptr;
+        std::atomic<metricShard*>& slot = threadMetrics().pages[p];
+        metricShard* page = slot.load(std::memory_order_relaxed);
+        if (!page) slot.store(page = new metricShard[metricPageSize], std::memory_order_release);
+        return page + id % metricPageSize;
+    }
+
+    //monotonically increasing count
+    class Counter {
+        size_t id;
+    public:
+        explicit Counter(const std::string& name, const std::string& help = "") : id(metricId(name, metricKind::counter, help)) {}
+        void inc(uint64_t n = 1) {
+            if (metricShard* s = metricShardFor(id)) s->value.store(s->value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        size_t getId() const { return id; }
+    };
+
+    //a value that goes up and down, last write wins so it is one shared atomic rather than per-thread shards
+    class Gauge {
+        std::atomic<double>* value;
+    public:
+        explicit Gauge(const std::string& name, const std::string& help = "") {
+            const size_t id = metricId(name, metricKind::gauge, help);
+            std::lock_guard<std::mutex> g(metrics().guard);
+            value = &metrics().infos[id].gauge;
+        }
+        void set(double v) { value->store(v, std::memory_order_relaxed); }
+        void add(double d) {
+            double cur = value->load(std::memory_order_relaxed);
+            while (!value->compare_exchange_weak(cur, cur + d, std::memory_order_relaxed)) {}
+        }
+        void sub(double d) { add(-d); }
+        double get() const { return value->load(std::memory_order_relaxed); }
+    };
+
+    //named distribution of unsigned values, recorded in the same log-linear buckets as histogram (the plain value type)
+    class HistogramMetric {
+        size_t id;
+    public:
+        explicit HistogramMetric(const std::string& name, const std::string& help = "") : id(metricId(name, metricKind::histogram, help)) {}
+        void record(uint64_t v) {
+            metricShard* s = metricShardFor(id);
+            if (!s) return;
+            metricHistShard* h = s->hist.load(std::memory_order_relaxed);
+            if (!h) s->hist.store(h = new metricHistShard(), std::memory_order_release);
+            std::atomic<uint64_t>& b = h->buckets[histogram::bucketOf(v)];
+            b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            h->total.store(h->total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            h->sum.store(h->sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+            if (v < h->minVal.load(std::memory_order_relaxed)) h->minVal.store(v, std::memory_order_relaxed);
+            if (v > h->maxVal.load(std::memory_order_relaxed)) h->maxVal.store(v, std::memory_order_relaxed);
+        }
+        size_t getId() const { return id; }
+    };
+
+    struct metricsSnapshot {
+        std::map<std::string, uint64_t> counters;
+        std::map<std::string, double> gauges;
+        std::map<std::string, histogram> histograms;
+        std::map<std::string, std::string> help;
+        std::chrono::steady_clock::time_point taken;
+    };
+
+    //sums every thread's shards into counts and hists by metric id, the caller holds metrics().guard
+    //existing entries are overwritten in place so a caller that keeps both around does not allocate once every metric has been seen
+    inline void sumMetrics(const metricRegistry& r, std::vector<uint64_t>& counts, std::map<size_t, histogram>& hists) {
+        counts.assign(r.retired.begin(), r.retired.end());
+        for (auto& h : hists) h.second.reset();
+        for (const auto& h : r.retiredHists) hists[h.first].merge(h.second);
+        for (metricThreadData* t : r.live) {
+            for (size_t p = 0; p < maxMetricPages; ++p) {
+                const metricShard* page = t->pages[p].load(std::memory_order_acquire);
+                if (!page) continue;
+                for (size_t i = 0; i < metricPageSize; ++i) {
+                    const size_t id = p * metricPageSize + i;
+                    if (id >= counts.size()) break;
+                    counts[id] += page[i].value.load(std::memory_order_relaxed);
+                    if (const metricHistShard* h = page[i].hist.load(std::memory_order_acquire)) h->addTo(hists[id]);
+                }
+            }
+        }
+    }
+
+    //every registered metric summed over live and exited threads
+    inline metricsSnapshot getMetrics() {
+        metricRegistry& r = metrics();
+        std::lock_guard<std::mutex> g(r.guard);
+        std::vector<uint64_t> counts;
+        std::map<size_t, histogram> hists;
+        sumMetrics(r, counts, hists);
+        metricsSnapshot s;
+        s.taken = std::chrono::steady_clock::now();
+        for (size_t id = 0; id < r.infos.size(); ++id) {
+            const metricInfo& info = r.infos[id];
+            if (!info.help.empty()) s.help[info.name] = info.help;
+            switch (info.kind) {
+            case metricKind::counter: s.counters[info.name] = counts[id]; break;
+            case metricKind::gauge: s.gauges[info.name] = info.gauge.load(std::memory_order_relaxed); break;
+            case metricKind::histogram: s.histograms[info.name] = hists[id]; break;
+            }
+        }
+        return s;
+    }
+
+    //prints counter increases and rates, current gauges and the histogram of values recorded between the snapshots
+    inline void compareMetrics(const metricsSnapshot& past, const metricsSnapshot& cur, std::ostream& os = std::cout) {
+        //an empty past snapshot (printMetrics) has no time to divide by
+        const double secs = past.taken == std::chrono::steady_clock::time_point() ? 0 : std::chrono::duration<double>(cur.taken - past.taken).count();
+        for (const auto& c : cur.counters) {
+            const auto p = past.counters.find(c.first);
+            const uint64_t d = c.second - (p == past.counters.end() ? 0 : p->second);
+            os << c.first << ": +" << d;
+            if (secs > 0) os << " (" << d / secs << "/s)";
+            os << ", total " << c.second << "\n";
+        }
+        for (const auto& g : cur.gauges) os << g.first << ": " << g.second << "\n";
+        for (const auto& h : cur.histograms) {
+            histogram d = h.second;
+            const auto p = past.histograms.find(h.first);
+            //min and max can't be subtracted, they stay the all-time values
+            if (p != past.histograms.end()) {
+                for (int i = 0; i < histogram::bucketCount; ++i) d.buckets[i] -= p->second.buckets[i];
+                d.total -= p->second.total;
+                d.sum -= p->second.sum;
+            }
+            os << h.first << ": ";
+            d.print(os);
+        }
+    }
+
+    //compares past against a fresh snapshot
+    inline void compareMetrics(const metricsSnapshot& past, std::ostream& os = std::cout) { compareMetrics(past, getMetrics(), os); }
+    inline void printMetrics(std::ostream& os = std::cout) { compareMetrics({}, getMetrics(), os); }
+#pragma endregion metrics
+#pragma region openmetrics
+    //renders the metrics registry and the process memory/CPU snapshot in the OpenMetrics text format and serves it to a scraper,
+    //either as a file that is replaced atomically or over HTTP on a loopback port
+    //buffers are members and reused and /proc is read into stack buffers, so after the first scrape rendering does not allocate
+    class metricsExporter {
+        std::mutex renderLock;
+        std::string out, name;
+        std::mutex fileLock;
+        std::string fileText;
+        std::vector<uint64_t> counts;
+        std::map<size_t, histogram> hists;
+        cpuBaseline cpu; //CPU percentages are per scrape interval
+
+        std::mutex stopLock;
+        std::condition_variable stopped;
+        bool stopping = false;
+        std::thread fileThread, httpThread;
+        int listenFd = -1;
+
+        //metric names may only hold [a-zA-Z0-9_:]
+        const std::string& sanitize(const std::string& n) {
+            name.assign(n);
+            for (char& c : name) if (!isalnum((unsigned char)c) && c != '_' && c != ':') c = '_';
+            if (!name.empty() && isdigit((unsigned char)name[0])) name.insert(name.begin(), '_');
+            return name;
+        }
+        void header(const std::string& n, const char* type, const char* help) { //const char* help, a std::string temporary would allocate
+            out += "# TYPE "; out += n; out += ' '; out += type; out += '\n';
+            if (*help) { out += "# HELP "; out += n; out += ' '; out += help; out += '\n'; }
+        }
+        void sample(const std::string& n, const char* suffix, const char* labels, double v) {
+            char num[64];
+            snprintf(num, sizeof(num), " %.17g\n", v);
+            out += n; out += suffix; out += labels; out += num;
+        }
+        void processMetric(const char* n, const char* type, const char* help, double v) {
+            name = n;
+            header(name, type, help);
+            sample(name, strcmp(type, "counter") ? "" : "_total", "", v);
+        }
+
+    public:
+        metricsExporter() = default;
+        metricsExporter(const metricsExporter&) = delete;
+        metricsExporter& operator=(const metricsExporter&) = delete;
+        ~metricsExporter() { stop(); }
+
+        //copies the exposition text into text while the render lock is still held, so the file and HTTP threads never share a buffer;
+        //text keeps its capacity from one scrape to the next
+        void render(std::string& text) {
+            std::lock_guard<std::mutex> g(renderLock);
+            out.clear();
+            const memory m = getData(cpu);
+            //the CPU percentages are negative until there is a previous reading to compare against
+            processMetric("process_resident_memory_bytes", "gauge", "Resident set size", (double)m.ramProg);
+            processMetric("process_virtual_memory_bytes", "gauge", "Virtual memory size", (double)m.virtProg);
+            processMetric("process_resident_memory_max_bytes", "gauge", "Peak resident set size", (double)m.ramPeak);
+            processMetric("process_cpu_seconds", "counter", "User and system CPU time", m.cpuSeconds);
+            if (m.cpuProg >= 0) processMetric("process_cpu_percent", "gauge", "CPU use of all processors since the previous reading", m.cpuProg);
+            processMetric("system_memory_bytes", "gauge", "Physical memory", (double)m.ramTotal);
+            processMetric("system_memory_used_bytes", "gauge", "Physical memory in use", (double)m.ramUsed);
+            if (m.cpuTotal >= 0) processMetric("system_cpu_percent", "gauge", "CPU use of the whole machine", m.cpuTotal);
+            processMetric("process_minor_page_faults", "counter", "Page faults served without I/O", (double)m.use.minorFaults);
+            processMetric("process_major_page_faults", "counter", "Page faults that needed I/O", (double)m.use.majorFaults);
+            processMetric("process_voluntary_context_switches", "counter", "", (double)m.use.voluntarySwitches);
+            processMetric("process_involuntary_context_switches", "counter", "", (double)m.use.involuntarySwitches);
+
+            metricRegistry& r = metrics();
+            std::lock_guard<std::mutex> rg(r.guard);
+            sumMetrics(r, counts, hists);
+            for (size_t id = 0; id < r.infos.size(); ++id) {
+                const metricInfo& info = r.infos[id];
+                sanitize(info.name);
+                switch (info.kind) {
+                case metricKind::counter:
+                    header(name, "counter", info.help.c_str());
+                    sample(name, "_total", "", (double)counts[id]);
+                    break;
+                case metricKind::gauge:
+                    header(name, "gauge", info.help.c_str());
+                    sample(name, "", "", info.gauge.load(std::memory_order_relaxed));
+                    break;
+                case metricKind::histogram: {
+                    header(name, "histogram", info.help.c_str());
+                    //cumulative counts at each power of two up to the largest value seen, finer buckets would swamp the scraper
+                    const histogram& h = hists[id];
+                    uint64_t seen = 0;
+                    char le[48];
+                    for (int i = 0; i < histogram::bucketCount && seen < h.total;) {
+                        const int end = i < histogram::subCount ? histogram::subCount : (i / histogram::subCount + 1) * histogram::subCount;
+                        for (; i < end; ++i) seen += h.buckets[i];
+                        snprintf(le, sizeof(le), "{le=\"%llu\"}", (unsigned long long)histogram::bucketHigh(end - 1));
+                        sample(name, "_bucket", le, (double)seen);
+                    }
+                    sample(name, "_bucket", "{le=\"+Inf\"}", (double)h.total);
+                    sample(name, "_count", "", (double)h.total);
+                    sample(name, "_sum", "", (double)h.sum);
+                    break;
+                }
+                }
+            }
+            out += "# EOF\n";
+            text.assign(out);
+        }
+        std::string render() {
+            std::string text;
+            render(text);
+            return text;
+        }
+
+        //renders to path + ".tmp" and renames it over path so a reader never sees a half written file
+        bool writeFile(const std::string& path) {
+            std::lock_guard<std::mutex> g(fileLock);
+            std::string& text = fileText;
+            render(text);
+            const std::string tmp = path + ".tmp";
+            FILE* f = fopen(tmp.c_str(), "wb");
+            if (!f) return false;
+            const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+            if (fclose(f) != 0 || !ok) return false;
+#ifdef _WIN32
+            return MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+            return rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+        }
+
+        //rewrites path every intervalSeconds on a background thread until stop()
+        void startFile(const std::string& path, double intervalSeconds = 10) {
+            if (fileThread.joinable()) return;
+            fileThread = std::thread([this, path, intervalSeconds] {
+                std::unique_lock<std::mutex> lock(stopLock);
+                while (!stopping) {
+                    lock.unlock();
+                    writeFile(path);
+                    lock.lock();
+                    stopped.wait_for(lock, std::chrono::duration<double>(intervalSeconds), [this] { return stopping; });
+                }
+            });
+        }
+
+#ifndef _WIN32
+        //answers every HTTP request on 127.0.0.1:port with the exposition text, port 0 picks a free one
+        //returns the bound port or -1, the responder runs on its own thread until stop()
+        int startHttp(int port = 0) {
+            if (httpThread.joinable()) return -1;
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (listenFd < 0) return -1;
+            const int one = 1;
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons((uint16_t)port);
+            socklen_t len = sizeof(addr);
+            if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 8) != 0 || getsockname(listenFd, (sockaddr*)&addr, &len) != 0) {
+                close(listenFd);
+                listenFd = -1;
+                return -1;
+            }
+            httpThread = std::thread([this] {
+                char request[4096];
+                std::string body, response;
+                for (;;) {
+                    {
+                        std::lock_guard<std::mutex> lock(stopLock);
+                        if (stopping) break;
+                    }
+                    pollfd p = { listenFd, POLLIN, 0 };
+                    if (poll(&p, 1, 200) <= 0) continue;
+                    const int c = accept(listenFd, nullptr, nullptr);
+                    if (c < 0) continue;
+                    //the request itself does not matter, every path gets the metrics
+                    pollfd cp = { c, POLLIN, 0 };
+                    if (poll(&cp, 1, 1000) > 0 && read(c, request, sizeof(request)) > 0) {
+                        render(body);
+                        char head[160];
+                        snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+                        response.assign(head);
+                        response += body;
+                        for (size_t sent = 0; sent < response.size();) {
+                            const ssize_t n = send(c, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                            if (n <= 0) break;
+                            sent += (size_t)n;
+                        }
+                    }
+                    close(c);
+                }
+            });
+            return ntohs(addr.sin_port);
+        }
+#endif
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(stopLock);
+                stopping = true;
+            }
+            stopped.notify_all();
+            if (fileThread.joinable()) fileThread.join();
+            if (httpThread.joinable()) httpThread.join();
+#ifndef _WIN32
+            if (listenFd >= 0) close(listenFd);
+            listenFd = -1;
+#endif
+        }
+    };
+#pragma endregion openmetrics
+#pragma region live_stats
+#ifndef _WIN32
+    //a POSIX shared memory segment, /mydbg.<pid>, that a background thread refreshes with the latest memory snapshot, metrics and zone tree
+    //viewers such as mydbg-top map it read-only, so watching a process costs it nothing beyond the periodic publish
+    //the payload is guarded by a seqlock: the writer makes seq odd, copies, makes it even, readers retry if seq moved under them
+    static const uint32_t liveStatsMagic = 0x4742444d, liveStatsVersion = 1; //"MDBG"
+    static const int maxLiveZones = 256, maxLiveMetrics = 256, liveNameLength = 64;
+
+    struct liveZone {
+        char name[liveNameLength];
+        uint32_t depth; //0 for the top level, children follow their parent
+        uint64_t count, cycles; //count is 0 for zones that are still open, cycles are then the sum of their children
+    };
+    struct liveMetric {
+        char name[liveNameLength];
+        uint32_t kind; //metricKind
+        double value; //counter total, gauge value or histogram count
+        uint64_t p50, p99, max; //histograms only
+    };
+    struct liveStatsData {
+        int64_t pid;
+        uint64_t publishes;
+        double publishedAt; //seconds since the publisher started
+        double clocksPerSecond;
+        unsigned long long virtProg, ramProg, ramPeak, ramTotal, ramUsed;
+        double cpuProg, cpuTotal, cpuSeconds;
+        long long minorFaults, majorFaults, voluntarySwitches, involuntarySwitches;
+        uint32_t zoneCount, metricCount;
+        liveZone zones[maxLiveZones];
+        liveMetric metrics[maxLiveMetrics];
+    };
+    struct liveStatsSegment {
+        uint32_t magic, version;
+        std::atomic<uint64_t> seq;
+        liveStatsData data;
+    };
+
+    inline std::string liveStatsName(long long pid) { return "/mydbg." + std::to_string(pid); }
+
+    //copies a consistent payload out of a mapped segment, false if the writer kept it busy for every try
+    inline bool readLiveStats(const liveStatsSegment* seg, liveStatsData& out, int tries = 100) {
+        for (int i = 0; i < tries; ++i) {
+            const uint64_t before = seg->seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            memcpy(&out, (const void*)&seg->data, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seg->seq.load(std::memory_order_relaxed) == before) return true;
+        }
+        return false;
+    }
+
+    //maps the segment of process pid read-only, nullptr if it does not publish one
+    inline const liveStatsSegment* openLiveStats(long long pid) {
+        const int fd = shm_open(liveStatsName(pid).c_str(), O_RDONLY, 0);
+        if (fd < 0) return nullptr;
+        void* p = mmap(nullptr, sizeof(liveStatsSegment), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        const liveStatsSegment* seg = (const liveStatsSegment*)p;
+        if (seg->magic != liveStatsMagic || seg->version != liveStatsVersion) {
+            munmap(p, sizeof(liveStatsSegment));
+            return nullptr;
+        }
+        return seg;
+    }
+    inline void closeLiveStats(const liveStatsSegment* seg) { if (seg) munmap((void*)seg, sizeof(liveStatsSegment)); }
+
+    //depth-first copy of the zone tree, children ordered by time like printZones
+    inline void flattenZones(const zoneTotals& tree, liveStatsData& d, uint32_t depth) {
+        std::vector<const zoneTotals*> kids;
+        for (const auto& c : tree.children) if (c.total()) kids.push_back(&c);
+        std::sort(kids.begin(), kids.end(), [](const zoneTotals* a, const zoneTotals* b) { return a->total() > b->total(); });
+        for (const zoneTotals* c : kids) {
+            if (d.zoneCount >= (uint32_t)maxLiveZones) return;
+            liveZone& z = d.zones[d.zoneCount++];
+            snprintf(z.name, sizeof(z.name), "%s", c->name().c_str());
+            z.depth = depth;
+            z.count = c->count;
+            z.cycles = c->total();
+            flattenZones(*c, d, depth + 1);
+        }
+    }
+
+    class liveStatsPublisher {
+        liveStatsSegment* seg = nullptr;
+        std::string shmName;
+        std::unique_ptr<liveStatsData> staged; //built off to the side so the seqlock is only held for a copy
+        std::chrono::steady_clock::time_point started;
+        cpuBaseline cpu; //CPU percentages are per publish interval
+        std::mutex stopLock;
+        std::condition_variable stopped;
+        bool stopping = false;
+        std::thread worker;
+
+    public:
+        liveStatsPublisher() = default;
+        liveStatsPublisher(const liveStatsPublisher&) = delete;
+        liveStatsPublisher& operator=(const liveStatsPublisher&) = delete;
+        ~liveStatsPublisher() { stop(); }
+
+        //creates the segment and refreshes it every intervalSeconds until stop(), false if the segment could not be created
+        bool start(double intervalSeconds = 0.5) {
+            if (seg) return true;
+            shmName = liveStatsName(getpid());
+            const int fd = shm_open(shmName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+            if (fd < 0) return false;
+            void* p = MAP_FAILED;
+            if (ftruncate(fd, sizeof(liveStatsSegment)) == 0) p = mmap(nullptr, sizeof(liveStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED) {
+                shm_unlink(shmName.c_str());
+                return false;
+            }
+            seg = new (p) liveStatsSegment();
+            seg->version = liveStatsVersion;
+            staged.reset(new liveStatsData());
+            started = std::chrono::steady_clock::now();
+            publish();
+            std::atomic_thread_fence(std::memory_order_release);
+            seg->magic = liveStatsMagic; //last, so a viewer never accepts a half initialised segment
+            stopping = false;
+            worker = std::thread([this, intervalSeconds] {
+                std::unique_lock<std::mutex> lock(stopLock);
+                while (!stopped.wait_for(lock, std::chrono::duration<double>(intervalSeconds), [this] { return stopping; })) {
+                    lock.unlock();
+                    publish();
+                    lock.lock();
+                }
+            });
+            return true;
+        }
+
+        //takes a fresh snapshot and copies it into the segment
+        void publish() {
+            if (!seg) return;
+            liveStatsData& d = *staged;
+            memset(&d, 0, sizeof(d));
+            d.pid = getpid();
+            d.publishedAt = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            d.clocksPerSecond = clocksPerSecond();
+            const memory m = getData(cpu);
+            d.virtProg = m.virtProg;
+            d.ramProg = m.ramProg;
+            d.ramPeak = m.ramPeak;
+            d.ramTotal = m.ramTotal;
+            d.ramUsed = m.ramUsed;
+            d.cpuProg = m.cpuProg;
+            d.cpuTotal = m.cpuTotal;
+            d.cpuSeconds = m.cpuSeconds;
+            d.minorFaults = m.use.minorFaults;
+            d.majorFaults = m.use.majorFaults;
+            d.voluntarySwitches = m.use.voluntarySwitches;
+            d.involuntarySwitches = m.use.involuntarySwitches;
+            flattenZones(getZones(), d, 0);
+            const metricsSnapshot s = getMetrics();
+            auto add = [&](const std::string& name, metricKind kind, double value) -> liveMetric* {
+                if (d.metricCount >= (uint32_t)maxLiveMetrics) return nullptr;
+                liveMetric& lm = d.metrics[d.metricCount++];
+                snprintf(lm.name, sizeof(lm.name), "%s", name.c_str());
+                lm.kind = (uint32_t)kind;
+                lm.value = value;
+                return &lm;
+            };
+            for (const auto& c : s.counters) add(c.first, metricKind::counter, (double)c.second);
+            for (const auto& g : s.gauges) add(g.first, metricKind::gauge, g.second);
+            for (const auto& h : s.histograms) {
+                if (liveMetric* lm = add(h.first, metricKind::histogram, (double)h.second.count())) {
+                    lm->p50 = h.second.percentile(.5);
+                    lm->p99 = h.second.percentile(.99);
+                    lm->max = h.second.max();
+                }
+            }
+
+            d.publishes = seg->data.publishes + 1;
+            const uint64_t seq = seg->seq.load(std::memory_order_relaxed);
+            seg->seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy((void*)&seg->data, &d, sizeof(d));
+            seg->seq.store(seq + 2, std::memory_order_release);
+        }
+
+        //stops publishing and removes the segment
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(stopLock);
+                stopping = true;
+            }
+            stopped.notify_all();
+            if (worker.joinable()) worker.join();
+            if (!seg) return;
+            munmap(seg, sizeof(liveStatsSegment));
+            shm_unlink(shmName.c_str());
+            seg = nullptr;
+        }
+    };
+#endif
+#pragma endregion live_stats
+#pragma region on_demand_dump
+    //the process' current memory and CPU figures, one per line
+    inline void writeMemory(std::ostream& os = std::cout) {
+        const memory m = getData();
+        os << "RAM: " << formatBytes((double)m.ramProg) << ", peak " << formatBytes((double)m.ramPeak) << "\nVirtual Memory: " << formatBytes((double)m.virtProg)
+            << "\nCPU: " << m.cpuSeconds << " s\nPage faults: " << m.use.minorFaults << " minor, " << m.use.majorFaults << " major\nContext switches: "
+            << m.use.voluntarySwitches << " voluntary, " << m.use.involuntarySwitches << " involuntary\n";
+    }
+
+    //everything the process can report about itself right now: memory/CPU, metrics, zones, locks and the sampled live heap
+    inline void writeSnapshot(std::ostream& os = std::cout) {
+        writeMemory(os);
+        os << "Metrics\n";
+        printMetrics(os);
+        printZones(os);
+        os << "Locks\n";
+        reportLocks(os);
+        bool sampled;
+        {
+            std::lock_guard<std::mutex> g(heap().lock);
+            sampled = !heap().sites.empty();
+        }
+        if (sampled) {
+            os << "Live heap\n";
+            reportLeaks(os);
+        }
+    }
+
+    //commands understood by the dump socket, "name args" -> handler writing its reply to os
+    typedef std::function<void(const std::string& args, std::ostream& os)> dumpCommand;
+    inline std::map<std::string, dumpCommand>& dumpCommands() {
+        static std::map<std::string, dumpCommand>* c = new std::map<std::string, dumpCommand>({
+            { "dump", [](const std::string&, std::ostream& os) { writeSnapshot(os); } },
+            { "memory", [](const std::string&, std::ostream& os) { writeMemory(os); } },
+            { "metrics", [](const std::string&, std::ostream& os) { printMetrics(os); } },
+            { "zones", [](const std::string&, std::ostream& os) { printZones(os); } },
+            { "locks", [](const std::string&, std::ostream& os) { reportLocks(os); } },
+            { "heap", [](const std::string& args, std::ostream& os) { if (args == "pprof") dumpHeapProfile(os, true); else reportLeaks(os); } },
+            //"zone" lists zones, "zone <rules>" takes the same syntax as DEBUGGER_ZONES, e.g. "zone -*,net.*"
+            { "zone", [](const std::string& args, std::ostream& os) {
+                for (const zoneRule& r : parseZoneRules(args.c_str())) setZones(r);
+                listZones(os);
+            } },
+        });
+        return *c;
+    }
+    //adds or replaces a socket command, e.g. addDumpCommand("queue", [](const std::string&, std::ostream& os) { os << queue.size() << "\n"; });
+    inline std::mutex& dumpCommandLock() {
+        static std::mutex* m = new std::mutex();
+        return *m;
+    }
+    inline void addDumpCommand(const std::string& name, dumpCommand fn) {
+        std::lock_guard<std::mutex> g(dumpCommandLock());
+        dumpCommands()[name] = std::move(fn);
+    }
+
+    //runs one "name args" command line, unknown names list the commands
+    inline void runDumpCommand(const std::string& line, std::ostream& os) {
+        const size_t space = line.find(' ');
+        const std::string name = line.substr(0, space), args = space == std::string::npos ? "" : line.substr(space + 1);
+        dumpCommand fn;
+        {
+            std::lock_guard<std::mutex> g(dumpCommandLock());
+            auto& commands = dumpCommands();
+            const auto it = commands.find(name.empty() ? "dump" : name);
+            if (it == commands.end()) {
+                os << "unknown command '" << name << "', commands:";
+                for (const auto& c : commands) os << " " << c.first;
+                os << "\n";
+                return;
+            }
+            fn = it->second;
+        }
+        fn(args, os);
+    }
+
+#ifndef _WIN32
+    struct dumpOptions {
+        int signal = SIGUSR1; //0 = don't install a handler
+        std::string outputPath; //where signal dumps are appended, empty = stderr
+        std::string socketPath = "default"; //Unix socket accepting command lines, "default" = /tmp/mydbg.<pid>.sock, empty = no socket
+    };
+
+    //signal dumps are formatted on a helper thread, the handler only sets a flag and writes a byte to a self-pipe to wake it
+    struct dumpListener {
+        std::mutex guard;
+        std::thread worker;
+        int wakeRead = -1, wakeWrite = -1, listenFd = -1;
+        std::atomic<bool> requested{ false }, stopping{ false };
+        dumpOptions opt;
+        struct sigaction previous = {};
+    };
+    inline dumpListener& dumps() {
+        static dumpListener* d = new dumpListener(); //leaked, the handler may fire during shutdown
+        return *d;
+    }
+
+    inline void dumpSignalHandler(int) {
+        const int saved = errno;
+        dumpListener& d = dumps();
+        d.requested.store(true, std::memory_order_relaxed);
+        const char b = 1;
+        if (write(d.wakeWrite, &b, 1) < 0) {} //full pipe means a dump is already pending
+        errno = saved;
+    }
+
+    //answers one socket client: reads a command line, writes the reply and closes
+    inline void serveDumpClient(int c) {
+        std::string line;
+        char buf[256];
+        pollfd p = { c, POLLIN, 0 };
+        while (line.find('\n') == std::string::npos && line.size() < 4096 && poll(&p, 1, 1000) > 0) {
+            const ssize_t n = read(c, buf, sizeof(buf));
+            if (n <= 0) break;
+            line.append(buf, (size_t)n);
+        }
+        line = line.substr(0, line.find_first_of("\r\n"));
+        std::ostringstream reply;
+        runDumpCommand(line, reply);
+        const std::string text = reply.str();
+        for (size_t sent = 0; sent < text.size();) {
+            const ssize_t n = send(c, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += (size_t)n;
+        }
+        close(c);
+    }
+
+    //appends a full snapshot to the configured output, called on the helper thread
+    inline void writeSignalDump(const dumpOptions& opt) {
+        std::ostringstream os;
+        const time_t now = time(nullptr);
+        tm local;
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &local));
+        os << "=== mydbg dump, pid " << getpid() << ", " << when << " ===\n";
+        writeSnapshot(os);
+        if (opt.outputPath.empty()) std::cerr << os.str() << std::flush;
+        else std::ofstream(opt.outputPath, std::ios::app) << os.str();
+    }
+
+    //starts the helper thread, installs the signal handler and opens the socket, returns false if any of them failed
+    //e.g. `kill -USR1 <pid>` or `echo zones | nc -U /tmp/mydbg.<pid>.sock`
+    inline bool startDumpListener(const dumpOptions& options = dumpOptions()) {
+        dumpListener& d = dumps();
+        std::lock_guard<std::mutex> g(d.guard);
+        if (d.worker.joinable()) return true;
+        d.opt = options;
+        if (d.opt.socketPath == "default") d.opt.socketPath = "/tmp/mydbg." + std::to_string(getpid()) + ".sock";
+        int fds[2];
+        if (pipe(fds) != 0) return false;
+        d.wakeRead = fds[0];
+        d.wakeWrite = fds[1];
+        fcntl(d.wakeWrite, F_SETFL, O_NONBLOCK);
+        fcntl(d.wakeRead, F_SETFL, O_NONBLOCK);
+        bool ok = true;
+        if (!d.opt.socketPath.empty()) {
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", d.opt.socketPath.c_str());
+            unlink(addr.sun_path); //left over from a crashed process with the same pid
+            d.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (d.listenFd < 0 || bind(d.listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(d.listenFd, 4) != 0) {
+                if (d.listenFd >= 0) close(d.listenFd);
+                d.listenFd = -1;
+                ok = false;
+            }
+            else chmod(addr.sun_path, 0600);
+        }
+        d.stopping = false;
+        d.worker = std::thread([&d] {
+            setThreadName("mydbg dump");
+            char drain[64];
+            for (;;) {
+                pollfd p[2] = { { d.wakeRead, POLLIN, 0 }, { d.listenFd, POLLIN, 0 } };
+                if (poll(p, d.listenFd >= 0 ? 2 : 1, -1) < 0 && errno != EINTR) break;
+                if (d.stopping) break;
+                while (read(d.wakeRead, drain, sizeof(drain)) > 0) {}
+                if (d.requested.exchange(false)) writeSignalDump(d.opt);
+                if (d.listenFd >= 0 && (p[1].revents & POLLIN)) {
+                    const int c = accept(d.listenFd, nullptr, nullptr);
+                    if (c >= 0) serveDumpClient(c);
+                }
+            }
+        });
+        if (d.opt.signal) {
+            struct sigaction sa = {};
+            sa.sa_handler = dumpSignalHandler;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESTART;
+            if (sigaction(d.opt.signal, &sa, &d.previous) != 0) ok = false;
+        }
+        return ok;
+    }
+
+    //restores the previous signal handler, removes the socket and joins the helper thread
+    inline void stopDumpListener() {
+        dumpListener& d = dumps();
+        std::lock_guard<std::mutex> g(d.guard);
+        if (!d.worker.joinable()) return;
+        if (d.opt.signal) sigaction(d.opt.signal, &d.previous, nullptr);
+        d.stopping = true;
+        const char b = 0;
+        if (write(d.wakeWrite, &b, 1) < 0) {}
+        d.worker.join();
+        if (d.listenFd >= 0) {
+            close(d.listenFd);
+            unlink(d.opt.socketPath.c_str());
+        }
+        close(d.wakeRead);
+        close(d.wakeWrite);
+        d.listenFd = d.wakeRead = d.wakeWrite = -1;
+    }
+#endif
+#pragma endregion on_demand_dump
+#pragma region hiccups
+    //one sampling window of the hiccup detector, with the memory snapshot taken at its end so stalls can be lined up with paging/reclaim
+    struct hiccupWindow {
+        uint64_t startClocks = 0, endClocks = 0; //clocks() at the window edges, comparable with timestamps taken by the application
+        histogram hiccups; //wake-up overshoot in ns
+        memory mem;
+    };
+
+    //jHiccup-style detector: a thread that sleeps for a short fixed interval and records how late it woke up
+    //the thread does no real work, so any overshoot is the platform (scheduler, page reclaim, THP compaction, hypervisor) and not the application
+    class hiccupMonitor {
+        mutable std::mutex guard;
+        histogram total;
+        std::deque<hiccupWindow> windows;
+        std::mutex stopLock;
+        std::condition_variable stopped;
+        bool stopping = false;
+        std::thread worker;
+
+    public:
+        size_t maxWindows = 3600; //oldest windows are dropped past this
+
+        hiccupMonitor() = default;
+        hiccupMonitor(const hiccupMonitor&) = delete;
+        hiccupMonitor& operator=(const hiccupMonitor&) = delete;
+        ~hiccupMonitor() { stop(); }
+
+        //sleeps intervalMs at a time and closes a window with a memory snapshot every windowSeconds
+        void start(double intervalMs = 1, double windowSeconds = 1) {
+            if (worker.joinable()) return;
+            stopping = false;
+            worker = std::thread([this, intervalMs, windowSeconds] {
+                setThreadName("mydbg hiccups");
+                const double nsPerClock = 1e9 / clocksPerSecond();
+                const uint64_t interval = (uint64_t)(intervalMs * 1e6 / nsPerClock), windowClocks = (uint64_t)(windowSeconds * 1e9 / nsPerClock);
+                const auto sleep = std::chrono::duration<double, std::milli>(intervalMs);
+                hiccupWindow w;
+                cpuBaseline cpu; //CPU percentages are per window
+                w.startClocks = clocks();
+                std::unique_lock<std::mutex> lock(stopLock);
+                for (;;) {
+                    const uint64_t before = clocks();
+                    if (stopped.wait_for(lock, sleep, [this] { return stopping; })) break;
+                    const uint64_t after = clocks(), slept = after - before;
+                    w.hiccups.record(slept > interval ? (uint64_t)((slept - interval) * nsPerClock) : 0);
+                    if (after - w.startClocks < windowClocks) continue;
+                    lock.unlock();
+                    w.endClocks = after;
+                    w.mem = getData(cpu);
+                    {
+                        std::lock_guard<std::mutex> g(guard);
+                        total.merge(w.hiccups);
+                        windows.push_back(w);
+                        while (windows.size() > maxWindows) windows.pop_front();
+                    }
+                    w = hiccupWindow();
+                    w.startClocks = clocks(); //the snapshot itself is not counted as a hiccup
+                    lock.lock();
+                }
+            });
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(stopLock);
+                stopping = true;
+            }
+            stopped.notify_all();
+            if (worker.joinable()) worker.join();
+        }
+
+        //overshoot over every completed window, in ns
+        histogram getHiccups() const {
+            std::lock_guard<std::mutex> g(guard);
+            return total;
+        }
+        std::vector<hiccupWindow> getWindows() const {
+            std::lock_guard<std::mutex> g(guard);
+            return std::vector<hiccupWindow>(windows.begin(), windows.end());
+        }
+        //largest hiccup in the windows overlapping [fromClocks, toClocks], e.g. around a slow request the application timed
+        uint64_t worstBetween(uint64_t fromClocks, uint64_t toClocks) const {
+            std::lock_guard<std::mutex> g(guard);
+            uint64_t worst = 0;
+            for (const hiccupWindow& w : windows) if (w.endClocks >= fromClocks && w.startClocks <= toClocks) worst = std::max(worst, w.hiccups.max());
+            return worst;
+        }
+
+        //the overall distribution, then one line per window whose worst hiccup reached thresholdNs with what memory and scheduling did in it
+        void report(std::ostream& os = std::cout, uint64_t thresholdNs = 1000000) const {
+            std::lock_guard<std::mutex> g(guard);
+            os << "Hiccups (ns) ";
+            total.print(os, "ns");
+            const double secsPerClock = 1 / clocksPerSecond();
+            const uint64_t origin = windows.empty() ? 0 : windows.front().startClocks;
+            for (size_t i = 0; i < windows.size(); ++i) {
+                const hiccupWindow& w = windows[i];
+                if (w.hiccups.max() < thresholdNs) continue;
+                os << "\t+" << (w.startClocks - origin) * secsPerClock << " s: max " << w.hiccups.max() / 1e6 << " ms, p99 " << w.hiccups.percentile(.99) / 1e6 << " ms, RAM "
+                    << formatBytes((double)w.mem.ramProg);
+                if (i) {
+                    const hiccupWindow& p = windows[i - 1];
+                    os << " (" << ((long long)w.mem.ramProg >= (long long)p.mem.ramProg ? "+" : "") << formatBytes((double)w.mem.ramProg - (double)p.mem.ramProg) << "), faults +"
+                        << w.mem.use.minorFaults - p.mem.use.minorFaults << " minor +" << w.mem.use.majorFaults - p.mem.use.majorFaults << " major, involuntary switches +"
+                        << w.mem.use.involuntarySwitches - p.mem.use.involuntarySwitches;
+                }
+                if (w.mem.cpuTotal >= 0) os << ", system CPU " << w.mem.cpuTotal << "%";
+                os << "\n";
+            }
+        }
+    };
+#pragma endregion hiccups
+#pragma region watchdog
+#ifndef _WIN32
+    //a thread that promised to call heartbeat() regularly
+    struct watchedThread {
+        pthread_t handle;
+        threadTrace* trace; //for the thread's name and current zone
+        std::atomic<uint64_t> lastBeat{ 0 }; //clocks() of the latest heartbeat
+        std::atomic<uint64_t> deadline{ 0 }; //clocks() allowed between heartbeats, 0 = the watchdog's default
+        uint64_t reportedBeat = 0; //lastBeat that was already reported as stuck, watchdog only
+        uint64_t id; //unique per registration, the entry's address may be reused by a later thread
+    };
+
+    struct watchdogOptions {
+        double deadlineSeconds = 1; //default time allowed between heartbeats
+        double checkSeconds = 0.1;
+        int signal = SIGUSR2; //sent to a stuck thread so it records its own stack
+        std::function<void(const std::string&)> onStall; //receives each report, default writes to stderr
+    };
+
+    struct watchdogState {
+        std::mutex guard;
+        std::vector<watchedThread*> threads;
+        watchdogOptions opt;
+        std::thread worker;
+        std::mutex stopLock;
+        std::condition_variable stopped;
+        bool stopping = false;
+        struct sigaction previous = {};
+        uint64_t nextId = 0;
+        //one stack capture at a time: the watchdog names the target's id, the target's signal handler claims it and fills frames
+        std::atomic<uint64_t> captureTarget{ 0 };
+        void* frames[64];
+        std::atomic<int> frameCount{ -1 };
+    };
+    inline watchdogState& watchdog() {
+        static watchdogState* w = new watchdogState(); //leaked, threads may beat during shutdown
+        return *w;
+    }
+
+    //the calling thread's entry, null until its first heartbeat; a plain pointer so the signal handler can reach it
+    inline watchedThread*& thisWatchedThread() {
+        thread_local watchedThread* w = nullptr;
+        return w;
+    }
+
+    //runs on the stuck thread: captureStack is primed before the watchdog starts so unwinding does not need to load anything here
+    inline void watchdogSignalHandler(int) {
+        const int saved = errno;
+        watchdogState& s = watchdog();
+        uint64_t id = thisWatchedThread() ? thisWatchedThread()->id : 0;
+        if (id && s.captureTarget.compare_exchange_strong(id, 0)) s.frameCount.store(captureStack(s.frames, 64, 1), std::memory_order_release);
+        errno = saved;
+    }
+
+    //registers the calling thread on first call and its entry is removed when the thread exits
+    //deadlineSeconds overrides the watchdog's default for this thread, e.g. for a loop that legitimately blocks longer
+    inline void heartbeat(double deadlineSeconds = 0) {
+        struct holder {
+            watchedThread w;
+            holder() {
+                w.handle = pthread_self();
+                w.trace = &thisThreadTrace(); //constructed first, so it outlives this holder
+                std::lock_guard<std::mutex> g(watchdog().guard);
+                w.id = ++watchdog().nextId;
+                watchdog().threads.push_back(&w);
+                thisWatchedThread() = &w;
+            }
+            ~holder() {
+                thisWatchedThread() = nullptr;
+                watchdogState& s = watchdog();
+                std::lock_guard<std::mutex> g(s.guard);
+                s.threads.erase(std::find(s.threads.begin(), s.threads.end(), &w));
+            }
+        };
+        thread_local holder h;
+        if (deadlineSeconds > 0) h.w.deadline.store((uint64_t)(deadlineSeconds * clocksPerSecond()), std::memory_order_relaxed);
+        h.w.lastBeat.store(clocks(), std::memory_order_relaxed);
+    }
+
+    //first lines of a stall report, the caller holds watchdog().guard so w cannot go away
+    inline std::string describeStuckThread(watchedThread& w, double secondsLate) {
+        std::ostringstream os;
+        std::lock_guard<std::mutex> g(w.trace->guard);
+        os << "watchdog: " << w.trace->name << " missed its heartbeat by " << secondsLate * 1e3 << " ms\n\tzone: " << zonePath(*w.trace, w.trace->current.load(std::memory_order_relaxed)) << "\n";
+        return os.str();
+    }
+
+    //signals the stuck thread registered as id to record its stack into s.frames, returns the frame count or 0
+    //s.guard is only held to send the signal, the wait runs without it so heartbeat() registration and thread exit go on
+    inline int captureStuckStack(watchdogState& s, const watchedThread* w, uint64_t id) {
+        if (!s.opt.signal) return 0;
+        {
+            std::lock_guard<std::mutex> g(s.guard);
+            //the thread may have exited, and its entry been reused, since it was found stuck
+            if (std::find(s.threads.begin(), s.threads.end(), w) == s.threads.end() || w->id != id) return 0;
+            s.frameCount.store(-1, std::memory_order_relaxed);
+            s.captureTarget.store(id, std::memory_order_release);
+            if (pthread_kill(w->handle, s.opt.signal) != 0) {
+                s.captureTarget.store(0);
+                return 0;
+            }
+        }
+        for (int i = 0; i < 100 && s.frameCount.load(std::memory_order_acquire) < 0; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        uint64_t unclaimed = id;
+        if (s.frameCount.load(std::memory_order_acquire) < 0 && s.captureTarget.compare_exchange_strong(unclaimed, 0)) return 0; //handler never ran
+        while (s.frameCount.load(std::memory_order_acquire) < 0) std::this_thread::yield(); //claimed, the handler is still unwinding
+        return std::max(0, s.frameCount.load(std::memory_order_acquire));
+    }
+
+    //starts the watchdog thread, threads are watched from their first heartbeat()
+    inline bool startWatchdog(const watchdogOptions& options = watchdogOptions()) {
+        watchdogState& s = watchdog();
+        std::lock_guard<std::mutex> g(s.guard);
+        if (s.worker.joinable()) return true;
+        s.opt = options;
+        if (!s.opt.onStall) s.opt.onStall = [](const std::string& r) { std::cerr << r << std::flush; };
+        primeStackCapture();
+        symbols(); //the symbolizer is built once here rather than while a thread is stuck
+        if (s.opt.signal) {
+            struct sigaction sa = {};
+            sa.sa_handler = watchdogSignalHandler;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESTART;
+            if (sigaction(s.opt.signal, &sa, &s.previous) != 0) return false;
+        }
+        s.stopping = false;
+        s.worker = std::thread([&s] {
+            const double perClock = 1 / clocksPerSecond();
+            const uint64_t defaultDeadline = (uint64_t)(s.opt.deadlineSeconds * clocksPerSecond());
+            std::unique_lock<std::mutex> lock(s.stopLock);
+            while (!s.stopped.wait_for(lock, std::chrono::duration<double>(s.opt.checkSeconds), [&s] { return s.stopping; })) {
+                struct stuck { const watchedThread* w; uint64_t id; std::string report; };
+                std::vector<stuck> found;
+                {
+                    std::lock_guard<std::mutex> g(s.guard);
+                    const uint64_t now = clocks();
+                    for (watchedThread* w : s.threads) {
+                        const uint64_t beat = w->lastBeat.load(std::memory_order_relaxed), limit = w->deadline.load(std::memory_order_relaxed);
+                        const uint64_t allowed = limit ? limit : defaultDeadline;
+                        //one report per missed heartbeat, the next beat re-arms it
+                        if (now - beat <= allowed || beat == w->reportedBeat) continue;
+                        w->reportedBeat = beat;
+                        found.push_back({ w, w->id, describeStuckThread(*w, (now - beat - allowed) * perClock) });
+                    }
+                }
+                //stacks are captured and symbolized after the guard is released
+                for (stuck& f : found) {
+                    const int n = captureStuckStack(s, f.w, f.id);
+                    if (n > 0) f.report += "\tstack:\n" + formatStack(s.frames, n, "\t\t");
+                    else f.report += "\tstack: not captured, the thread did not run its signal handler\n";
+                    s.opt.onStall(f.report);
+                }
+            }
+        });
+        return true;
+    }
+
+    inline void stopWatchdog() {
+        watchdogState& s = watchdog();
+        {
+            std::lock_guard<std::mutex> lock(s.stopLock);
+            s.stopping = true;
+        }
+        s.stopped.notify_all();
+        if (s.worker.joinable()) s.worker.join();
+        std::lock_guard<std::mutex> g(s.guard);
+        if (s.opt.signal) sigaction(s.opt.signal, &s.previous, nullptr);
+    }
+#endif
+#pragma endregion watchdog
+#pragma region loop_monitor
+    //periodic behaviour of a fixed-rate loop (tick, frame, poll loop), used from the thread that runs it:
+    //    LoopMonitor ingest("ingest", 1e-3);
+    //    for (;;) { ingest.begin(); work(); ingest.end(); waitForNextTick(); }
+    //an iteration whose work overruns the budget is a deadline miss and is charged to the zones that ran during it
+    class LoopMonitor {
+        struct missZone { uint64_t misses = 0, cycles = 0; };
+
+        std::string name;
+        uint64_t period, budget; //clocks()
+        double nsPerClock;
+        uint64_t start = 0, lastStart = 0;
+        threadTrace* trace = nullptr;
+        std::vector<std::pair<uint32_t, uint64_t>> log, byNode;
+        std::vector<std::pair<uint32_t, uint64_t>>* outerLog = nullptr; //an enclosing monitor's log, restored at end()
+        std::map<std::string, missZone> missZones;
+
+    public:
+        uint64_t iterations = 0, misses = 0;
+        uint64_t longestGap = 0, longestWork = 0; //ns
+        histogram periods, work, jitter; //ns, jitter is the distance of each period from the target
+
+        //budgetSeconds defaults to the whole period
+        LoopMonitor(std::string name, double periodSeconds, double budgetSeconds = 0) : name(std::move(name)) {
+            const double cps = clocksPerSecond();
+            nsPerClock = 1e9 / cps;
+            period = (uint64_t)(periodSeconds * cps);
+            budget = (uint64_t)((budgetSeconds > 0 ? budgetSeconds : periodSeconds) * cps);
+        }
+        LoopMonitor(const LoopMonitor&) = delete;
+        LoopMonitor& operator=(const LoopMonitor&) = delete;
+
+        void begin() {
+            start = clocks();
+            if (lastStart) {
+                const uint64_t p = start - lastStart, ns = (uint64_t)(p * nsPerClock);
+                periods.record(ns);
+                jitter.record((uint64_t)((p > period ? p - period : period - p) * nsPerClock));
+                longestGap = std::max(longestGap, ns);
+            }
+            lastStart = start;
+            if (zonesGone()) return;
+            trace = &thisThreadTrace();
+            log.clear();
+            outerLog = trace->log;
+            trace->log = &log;
+        }
+
+        void end() {
+            const uint64_t w = clocks() - start, ns = (uint64_t)(w * nsPerClock);
+            ++iterations;
+            work.record(ns);
+            longestWork = std::max(longestWork, ns);
+            if (!trace) return;
+            trace->log = outerLog;
+            if (outerLog) outerLog->insert(outerLog->end(), log.begin(), log.end());
+            if (w <= budget) return;
+            ++misses;
+            //a zone entered several times in the iteration is charged once per miss with its summed time
+            byNode.assign(log.begin(), log.end());
+            std::sort(byNode.begin(), byNode.end());
+            instrumentPause pause;
+            std::lock_guard<std::mutex> g(trace->guard);
+            for (size_t i = 0; i < byNode.size();) {
+                uint64_t cycles = 0;
+                size_t j = i;
+                for (; j < byNode.size() && byNode[j].first == byNode[i].first; ++j) cycles += byNode[j].second;
+                missZone& z = missZones[zonePath(*trace, byNode[i].first)];
+                ++z.misses;
+                z.cycles += cycles;
+                i = j;
+            }
+        }
+
+        //begin()/end() as a scope
+        struct iteration {
+            LoopMonitor& m;
+            explicit iteration(LoopMonitor& m) : m(m) { m.begin(); }
+            iteration(const iteration&) = delete;
+            iteration& operator=(const iteration&) = delete;
+            ~iteration() { m.end(); }
+        };
+
+        void report(std::ostream& os = std::cout, size_t topZones = 10) const {
+            os << name << ": " << iterations << " iterations, target period " << period * nsPerClock / 1e3 << " us, budget " << budget * nsPerClock / 1e3 << " us, "
+                << misses << " deadline misses (" << (iterations ? misses * 100.0 / iterations : 0) << "%), longest gap " << longestGap / 1e3 << " us, longest work " << longestWork / 1e3 << " us\n";
+            os << "\tPeriod ";
+            periods.print(os, "ns");
+            os << "\tWork ";
+            work.print(os, "ns");
+            os << "\tJitter ";
+            jitter.print(os, "ns");
+            if (missZones.empty()) return;
+            std::vector<std::pair<uint64_t, std::string>> order;
+            for (const auto& z : missZones) order.push_back({ z.second.cycles, z.first });
+            std::sort(order.rbegin(), order.rend());
+            os << "\tZones in missed iterations:\n";
+            for (size_t i = 0; i < order.size() && i < topZones; ++i) {
+                const missZone& z = missZones.at(order[i].second);
+                os << "\t\t" << order[i].second << ": in " << z.misses << " misses, " << z.cycles * nsPerClock / 1e3 / z.misses << " us avg per miss\n";
+            }
+        }
+    };
+#pragma endregion loop_monitor
+}
+
+//allocation hooks for the heap profiler, define DEBUGGER_HEAP_PROFILER in exactly one .cpp before including this header
+//every block gets a 16 byte header so frees can tell sampled allocations apart without a lookup
+//setting DEBUGGER_HEAP_PROFILE=<path> in the environment writes heapProfileAtExit(path)
+#ifdef DEBUGGER_HEAP_PROFILER
+#include <new>
+namespace Debugger {
+    struct heapHeader { uint64_t offset; uint32_t magic, sampled; };
+    const uint32_t heapMagic = 0x48504446;
+
+    inline void* heapAlloc(size_t size, size_t align) {
+        if (align < 16) align = 16;
+        const size_t offset = align; //header sits in the padding just below the user pointer
+#ifdef _MSC_VER
+        char* raw = (char*)_aligned_malloc(size + offset, align);
+#else
+        char* raw = (char*)aligned_alloc(align, (size + offset + align - 1) / align * align);
+#endif
+        if (!raw) return nullptr;
+        void* user = raw + offset;
+        heapHeader* hdr = (heapHeader*)user - 1;
+        hdr->offset = offset;
+        hdr->magic = heapMagic;
+        hdr->sampled = shouldSampleAlloc(size);
+        if (hdr->sampled) recordHeapAlloc(user, size);
+        return user;
+    }
+    inline void heapFree(void* p) {
+        if (!p) return;
+        heapHeader* hdr = (heapHeader*)p - 1;
+        if (hdr->sampled) recordHeapFree(p);
+#ifdef _MSC_VER
+        _aligned_free((char*)p - hdr->offset);
+#else
+        free((char*)p - hdr->offset);
+#endif
+    }
+    inline void* heapAllocOrThrow(size_t size, size_t align) {
+        for (;;) {
+            if (void* p = heapAlloc(size ? size : 1, align)) return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    static const bool heapProfileFromEnv = [] {
+        if (const char* path = getenv("DEBUGGER_HEAP_PROFILE")) heapProfileAtExit(path);
+        return true;
+    }();
+}
+
+void* operator new(size_t size) { return Debugger::heapAllocOrThrow(size, 16); }
+void* operator new[](size_t size) { return Debugger::heapAllocOrThrow(size, 16); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Debugger::heapAlloc(size ? size : 1, 16); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Debugger::heapAlloc(size ? size : 1, 16); }
+void* operator new(size_t size, std::align_val_t align) { return Debugger::heapAllocOrThrow(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return Debugger::heapAllocOrThrow(size, (size_t)align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Debugger::heapAlloc(size ? size : 1, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return Debugger::heapAlloc(size ? size : 1, (size_t)align); }
+void operator delete(void* p) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p) noexcept { Debugger::heapFree(p); }
+void operator delete(void* p, size_t) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p, size_t) noexcept { Debugger::heapFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { Debugger::heapFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { Debugger::heapFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { Debugger::heapFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { Debugger::heapFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { Debugger::heapFree(p); }
+#endif
+
+//entry/exit hooks for -finstrument-functions (GCC/Clang), define DEBUGGER_INSTRUMENT_FUNCTIONS in exactly one .cpp before
+//including this header; every instrumented function then shows up in printZones() under its symbol name
+//-finstrument-functions alone is enough, add -finstrument-functions-exclude-file-list=Debugger.h,/usr/include to keep the
+//profiler and the standard library out of the tree
+#if defined(DEBUGGER_INSTRUMENT_FUNCTIONS) && !defined(_MSC_VER)
+extern "C" {
+    //busy is set before anything else runs, so instrumented code the hooks reach (standard library templates) returns at once
+    DEBUGGER_NO_INSTRUMENT void __cyg_profile_func_enter(void* fn, void*) {
+        bool& busy = Debugger::inInstrumentHook();
+        if (busy) return;
+        busy = true;
+        //inside a zone visit that was not sampled, like nested zones
+        if (!Debugger::threadZoneSampling().skipped && Debugger::instrumentAllowed(fn)) Debugger::zoneEnter(fn, true);
+        busy = false;
+    }
+    DEBUGGER_NO_INSTRUMENT void __cyg_profile_func_exit(void* fn, void*) {
+        bool& busy = Debugger::inInstrumentHook();
+        if (busy) return;
+        busy = true;
+        if (!Debugger::threadZoneSampling().skipped && Debugger::instrumentAllowed(fn))
+            Debugger::zoneExit(Debugger::instrumentation().minCycles.load(std::memory_order_relaxed), Debugger::threadZoneSampling().scale);
+        busy = false;
+    }
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+//mydbg-top: live view of a process that publishes Debugger::liveStatsPublisher stats
+//usage: mydbg-top <pid> [refresh seconds]
+//reads the /mydbg.<pid> shared memory segment, the watched process does no work for the viewer
+
+#include "../myDebugger/Debugger.h"
+
+#ifdef _WIN32
+int main() {
+    std::cerr << "mydbg-top needs POSIX shared memory\n";
+    return 1;
+}
+#else
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <pid> [refresh seconds]\n";
+        return 1;
+    }
+    const long long pid = atoll(argv[1]);
+    const double interval = argc > 2 ? atof(argv[2]) : 1;
+    const Debugger::liveStatsSegment* seg = Debugger::openLiveStats(pid);
+    if (!seg) {
+        std::cerr << "no live stats for process " << pid << " (" << Debugger::liveStatsName(pid) << ")\n";
+        return 1;
+    }
+
+    std::unique_ptr<Debugger::liveStatsData> cur(new Debugger::liveStatsData()), prev(new Debugger::liveStatsData());
+    bool havePrev = false;
+    while (kill((pid_t)pid, 0) == 0 || errno == EPERM) {
+        if (!Debugger::readLiveStats(seg, *cur)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        const Debugger::liveStatsData& d = *cur;
+        const double secs = havePrev ? d.publishedAt - prev->publishedAt : 0;
+        std::cout << "\x1b[H\x1b[2J"; //home and clear
+        std::cout << "pid " << d.pid << ", up " << d.publishedAt << " s, update " << d.publishes << "\n";
+        std::cout << "RAM " << Debugger::formatBytes((double)d.ramProg) << " (peak " << Debugger::formatBytes((double)d.ramPeak) << "), virtual "
+            << Debugger::formatBytes((double)d.virtProg) << ", system " << Debugger::formatBytes((double)d.ramUsed) << " / " << Debugger::formatBytes((double)d.ramTotal) << "\n";
+        std::cout << "CPU " << d.cpuSeconds << " s";
+        if (secs > 0) std::cout << " (" << (d.cpuSeconds - prev->cpuSeconds) / secs * 100 << "% of one core)";
+        std::cout << ", page faults " << d.minorFaults << " minor / " << d.majorFaults << " major, context switches " << d.voluntarySwitches << " / " << d.involuntarySwitches << "\n";
+
+        if (d.metricCount) std::cout << "\nMetrics\n";
+        for (uint32_t i = 0; i < d.metricCount && i < (uint32_t)Debugger::maxLiveMetrics; ++i) {
+            const Debugger::liveMetric& m = d.metrics[i];
+            std::cout << "\t" << m.name << ": ";
+            switch ((Debugger::metricKind)m.kind) {
+            case Debugger::metricKind::counter: {
+                std::cout << (uint64_t)m.value;
+                //counters keep their position between updates unless new metrics were registered
+                if (secs > 0 && i < prev->metricCount && !strcmp(prev->metrics[i].name, m.name)) std::cout << " (" << (m.value - prev->metrics[i].value) / secs << "/s)";
+                break;
+            }
+            case Debugger::metricKind::gauge: std::cout << m.value; break;
+            case Debugger::metricKind::histogram: std::cout << (uint64_t)m.value << " values, p50 " << m.p50 << ", p99 " << m.p99 << ", max " << m.max; break;
+            }
+            std::cout << "\n";
+        }
+
+        if (d.zoneCount) std::cout << "\nZones\n";
+        const double msPerClock = d.clocksPerSecond > 0 ? 1e3 / d.clocksPerSecond : 0;
+        for (uint32_t i = 0; i < d.zoneCount && i < (uint32_t)Debugger::maxLiveZones; ++i) {
+            const Debugger::liveZone& z = d.zones[i];
+            std::cout << std::string(z.depth + 1, '\t') << z.name << ": ";
+            if (z.count) std::cout << z.count << " calls, " << z.cycles * msPerClock << " ms, " << z.cycles * msPerClock * 1e3 / z.count << " us avg\n";
+            else std::cout << "open, " << z.cycles * msPerClock << " ms in children\n";
+        }
+        std::cout.flush();
+
+        std::swap(cur, prev);
+        havePrev = true;
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+    std::cout << "process " << pid << " exited\n";
+    Debugger::closeLiveStats(seg);
+    return 0;
+}
+#endif